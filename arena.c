@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Bump allocator for data sharing a single lifetime
+ *
+ * Copyright 2025 Google LLC
+ */
+#include <string.h>
+
+#include "arena.h"
+
+struct arena *new_arena(size_t chunk_size)
+{
+	struct arena *a;
+
+	a = calloc(1, sizeof(*a));
+	if (!a)
+		return NULL;
+	a->chunk_size = chunk_size;
+	return a;
+}
+
+void destroy_arena(struct arena *a)
+{
+	struct arena_chunk *chunk;
+	struct arena_chunk *next;
+
+	for (chunk = a->head; chunk; chunk = next) {
+		next = chunk->next;
+		free(chunk);
+	}
+	free(a);
+}
+
+void *arena_alloc_slow(struct arena *a, size_t size)
+{
+	struct arena_chunk *chunk;
+	size_t chunk_size;
+
+	/* After a reset, the chunks past the current one are free for reuse. */
+	chunk = a->current ? a->current->next : a->head;
+	if (!chunk || chunk->size < size) {
+		chunk_size = size > a->chunk_size ? size : a->chunk_size;
+		chunk = malloc(sizeof(*chunk) + chunk_size);
+		if (!chunk)
+			return NULL;
+		chunk->size = chunk_size;
+		/* Insert the chunk before any that were too small, so they stay in the list. */
+		if (a->current) {
+			chunk->next = a->current->next;
+			a->current->next = chunk;
+		} else {
+			chunk->next = a->head;
+			a->head = chunk;
+		}
+	}
+
+	a->current = chunk;
+	a->pos = size;
+	return chunk->data;
+}
+
+void *arena_grow(struct arena *a, void *ptr, size_t old_size, size_t new_size)
+{
+	char *end = (char *)ptr + old_size;
+	void *ret;
+
+	if (ptr && a->current && end == a->current->data + a->pos &&
+	    new_size - old_size <= a->current->size - a->pos) {
+		a->pos += new_size - old_size;
+		return ptr;
+	}
+
+	ret = arena_alloc(a, new_size);
+	if (ret && ptr)
+		memcpy(ret, ptr, old_size);
+	return ret;
+}
+
+char *arena_strndup(struct arena *a, const char *s, size_t len)
+{
+	char *ret;
+
+	ret = arena_alloc(a, len + 1);
+	if (!ret)
+		return NULL;
+	memcpy(ret, s, len);
+	ret[len] = '\0';
+	return ret;
+}
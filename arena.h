@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Bump allocator for data sharing a single lifetime
+ *
+ * Copyright 2025 Google LLC
+ */
+#ifndef ARENA_H
+#define ARENA_H 1
+
+#include <stddef.h>
+#include <stdlib.h>
+
+/* Alignment of every allocation, enough for any primitive type. */
+#define ARENA_ALIGN 16
+
+struct arena_chunk {
+	struct arena_chunk *next;
+	size_t size;
+	char data[] __attribute__((aligned(ARENA_ALIGN)));
+};
+
+/**
+ * struct arena - a bump allocator
+ *
+ * @head: the first chunk, or NULL until the first allocation.
+ * @current: the chunk allocations are carved from.
+ * @pos: offset of the first free byte of @current.
+ * @chunk_size: the size of new chunks, unless an allocation needs more.
+ *
+ * Allocations are never freed individually. Instead, the whole arena is
+ * either destroyed or reset, which rewinds it to its first chunk in O(1)
+ * while keeping every chunk for reuse. An arena that is reset between inputs
+ * thus stops calling malloc() once it has seen its largest input.
+ */
+struct arena {
+	struct arena_chunk *head;
+	struct arena_chunk *current;
+	size_t pos;
+	size_t chunk_size;
+};
+
+/**
+ * new_arena - create an empty arena
+ *
+ * @chunk_size: the size of the chunks memory is carved from. Larger
+ *	allocations get a chunk of their own.
+ *
+ * @return the new arena, or NULL on failure.
+ */
+struct arena *new_arena(size_t chunk_size);
+
+void destroy_arena(struct arena *a);
+
+void *arena_alloc_slow(struct arena *a, size_t size);
+
+/**
+ * arena_alloc - allocate memory from an arena
+ *
+ * @return ARENA_ALIGN-aligned, uninitialized memory, valid until the arena is
+ * reset or destroyed, or NULL on failure.
+ */
+static inline void *arena_alloc(struct arena *a, size_t size)
+{
+	size_t pos = (a->pos + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+	if (a->current && size <= a->current->size && pos <= a->current->size - size) {
+		a->pos = pos + size;
+		return a->current->data + pos;
+	}
+	return arena_alloc_slow(a, size);
+}
+
+/**
+ * arena_grow - resize the last allocation of an arena, or move it
+ *
+ * @a: the arena.
+ * @ptr: memory allocated from @a, or NULL.
+ * @old_size: the size of @ptr.
+ * @new_size: the requested size, at least @old_size.
+ *
+ * Extends @ptr in place if it is the most recent allocation and its chunk has
+ * room. Otherwise, @ptr is copied to a new allocation, and its old memory is
+ * only reclaimed when the arena is reset.
+ *
+ * @return the resized memory, or NULL on failure, in which case @ptr is left
+ * untouched.
+ */
+void *arena_grow(struct arena *a, void *ptr, size_t old_size, size_t new_size);
+
+/* Copies @len bytes of @s to a NUL-terminated string in @a. */
+char *arena_strndup(struct arena *a, const char *s, size_t len);
+
+/* Makes all of @a's memory available again, without returning it to the system. */
+static inline void arena_reset(struct arena *a)
+{
+	a->current = a->head;
+	a->pos = 0;
+}
+
+#endif /* ARENA_H */
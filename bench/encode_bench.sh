@@ -0,0 +1,41 @@
+#!/bin/sh
+# SPDX-License-Identifier: GPL-2.0
+#
+# Measures encoder throughput for a few schemas, without a KFuzzTest kernel.
+#
+# Usage: bench/encode_bench.sh [<bridge> ...]
+#
+# Every bridge binary given (default ./kfuzztest_bridge) encodes the same
+# inputs from the built-in PRNG and discards them, so that two builds can be
+# compared side by side. Set ITERATIONS to change the number of inputs per run.
+
+set -e
+
+ITERATIONS=${ITERATIONS:-2000}
+
+[ $# -gt 0 ] || set -- ./kfuzztest_bridge
+
+# <name> <schema>, one per line.
+SCHEMAS='small     a { u32 ptr[b] u64 }; b { arr[u8, 16] };
+prims     a { u8 u16 u32 u64 u8 u16 u32 u64 u8 u16 u32 u64 u8 u16 u32 u64 };
+arr4k     a { u32 ptr[b] }; b { arr[u8, 4096] };
+arr64k    a { arr[u8, 65536] };
+arr64x1k  a { arr[u64, 1024] ptr[b] }; b { arr[u32, 1024] ptr[c] }; c { arr[u16, 1024] };'
+
+now_ns() {
+	date +%s%N
+}
+
+printf '%-10s %-32s %12s %10s\n' schema bridge inputs/sec MB/sec
+echo "$SCHEMAS" | while read -r name schema; do
+	for bridge in "$@"; do
+		out=$(mktemp)
+		start=$(now_ns)
+		"$bridge" -R1 -n "$ITERATIONS" -o "$out" "$schema" bench >/dev/null
+		end=$(now_ns)
+		bytes=$(stat -c %s "$out")
+		rm -f "$out"
+		awk -v n="$name" -v b="$bridge" -v i="$ITERATIONS" -v t=$((end - start)) -v s="$bytes" \
+			'BEGIN { printf "%-10s %-32s %12.0f %10.1f\n", n, b, i / (t / 1e9), s / (t / 1e9) / 1e6 }'
+	done
+done
@@ -0,0 +1,54 @@
+#!/bin/sh
+# SPDX-License-Identifier: GPL-2.0
+#
+# Checks the binary layout of a few schemas, without a KFuzzTest kernel.
+#
+# Usage: bench/layout_check.sh [<bridge>]
+#
+# Each schema is encoded once through the file sink, and the region array and
+# relocation table of the input are compared to offsets and sizes worked out
+# by hand, the way a C compiler would lay the regions out. Exits non-zero if
+# any of them differ.
+
+set -e
+
+BRIDGE=${1:-./kfuzztest_bridge}
+
+# <schema>|<regions>|<relocations>, one per line. Regions are listed as
+# offset:size and relocations as src:offset:dst.
+CASES='a { u8 ptr[b] u16 }; b { u8 };|0:24 32:1|0:8:1
+a { u8 u16 u32 u64 };|0:16|
+a { u32 ptr[b] u64 }; b { arr[u8, 16] };|0:24 32:16|0:8:1
+a { u64 u8 }; b { u16 u8 };|0:16 24:4|
+a { u8 };|0:1|'
+
+out=$(mktemp)
+trap 'rm -f "$out"' EXIT
+
+# Prints the <count> little-endian u32 values at byte <offset> of the input.
+u32s() {
+	od -An -tu4 -v -j $((4 + $1)) -N $((4 * $2)) "$out" | tr -s ' \n' ' ' | sed 's/^ //; s/ $//'
+}
+
+fail=0
+echo "$CASES" | {
+	while IFS='|' read -r schema regions relocs; do
+		"$BRIDGE" -R1 -n 1 -o "$out" "$schema" check >/dev/null
+
+		num_regions=$(u32s 8 1)
+		got_regions=$(u32s 12 $((2 * num_regions)) | awk '{ for (i = 1; i < NF; i += 2) printf "%s%s:%s", (i > 1 ? " " : ""), $i, $(i + 1) }')
+		pos=$((12 + 8 * num_regions))
+		num_relocs=$(u32s $pos 1)
+		got_relocs=
+		[ "$num_relocs" -eq 0 ] ||
+			got_relocs=$(u32s $((pos + 8)) $((3 * num_relocs)) | awk '{ for (i = 1; i < NF; i += 3) printf "%s%s:%s:%s", (i > 1 ? " " : ""), $i, $(i + 1), $(i + 2) }')
+
+		if [ "$got_regions" != "$regions" ] || [ "$got_relocs" != "$relocs" ]; then
+			echo "FAIL $schema"
+			echo "  expected regions '$regions' relocations '$relocs'"
+			echo "  got      regions '$got_regions' relocations '$got_relocs'"
+			fail=1
+		fi
+	done
+	exit $fail
+}
@@ -0,0 +1,54 @@
+#!/bin/sh
+# SPDX-License-Identifier: GPL-2.0
+#
+# Measures how schema compilation and encoding scale with the number of
+# regions, without a KFuzzTest kernel.
+#
+# Usage: bench/scale_bench.sh [<bridge>]
+#
+# Each schema is a ring of regions, every one holding a pointer to the next,
+# so there are as many relocations as regions. Schemas this large exceed the
+# maximum length of a command-line argument, so they are passed as a
+# single-target campaign. Both the compile time and the encode time per
+# region should stay flat as the number of regions grows. Set REGIONS to
+# change the schema sizes, and BUDGET to change the number of regions encoded
+# per measurement.
+
+set -e
+
+BRIDGE=${1:-./kfuzztest_bridge}
+REGIONS=${REGIONS:-10 100 1000 10000 100000}
+BUDGET=${BUDGET:-2000000}
+
+now_ns() {
+	date +%s%N
+}
+
+# Runs <campaign> for <iterations> inputs and prints the elapsed time in ns.
+run() {
+	start=$(now_ns)
+	"$BRIDGE" -R1 -n "$2" -o /dev/null -c "$1" >/dev/null
+	echo $(($(now_ns) - start))
+}
+
+campaign=$(mktemp)
+trap 'rm -f "$campaign"' EXIT
+
+printf '%10s %10s %14s %14s %14s\n' regions inputs compile_ms us/input ns/region
+for n in $REGIONS; do
+	awk -v n="$n" 'BEGIN {
+		printf "bench "
+		for (i = 0; i < n; i++)
+			printf "r%d { u32 ptr[r%d] arr[u8, 8] }; ", i, (i + 1) % n
+		printf "\n"
+	}' >"$campaign"
+
+	iterations=$((BUDGET / n))
+	[ "$iterations" -gt 1 ] || iterations=2
+	once=$(run "$campaign" 1)
+	many=$(run "$campaign" "$iterations")
+	awk -v n="$n" -v i="$iterations" -v once="$once" -v many="$many" 'BEGIN {
+		per_input = (many - once) / (i - 1)
+		printf "%10d %10d %14.2f %14.2f %14.2f\n", n, i, once / 1e6, per_input / 1e3, per_input / n
+	}'
+done
@@ -10,32 +10,25 @@
 
 #include "byte_buffer.h"
 
-struct byte_buffer *new_byte_buffer(size_t initial_size)
+struct byte_buffer *new_byte_buffer(struct arena *arena, size_t initial_size)
 {
 	struct byte_buffer *ret;
 	size_t alloc_size = initial_size >= 8 ? initial_size : 8;
 
-	ret = malloc(sizeof(*ret));
+	ret = arena_alloc(arena, sizeof(*ret));
 	if (!ret)
 		return NULL;
 
 	ret->alloc_size = alloc_size;
-	ret->buffer = malloc(alloc_size);
-	if (!ret->buffer) {
-		free(ret);
+	ret->buffer = arena_alloc(arena, alloc_size);
+	if (!ret->buffer)
 		return NULL;
-	}
 	ret->num_bytes = 0;
+	ret->arena = arena;
 	return ret;
 }
 
-void destroy_byte_buffer(struct byte_buffer *buf)
-{
-	free(buf->buffer);
-	free(buf);
-}
-
-int append_bytes(struct byte_buffer *buf, const char *bytes, size_t num_bytes)
+int append_space(struct byte_buffer *buf, size_t num_bytes, char **ret)
 {
 	size_t req_size;
 	size_t new_size;
@@ -47,17 +40,28 @@ int append_bytes(struct byte_buffer *buf, const char *bytes, size_t num_bytes)
 	while (req_size > new_size)
 		new_size *= 2;
 	if (new_size != buf->alloc_size) {
-		new_ptr = realloc(buf->buffer, new_size);
-		if (!buf->buffer)
+		new_ptr = arena_grow(buf->arena, buf->buffer, buf->alloc_size, new_size);
+		if (!new_ptr)
 			return -ENOMEM;
 		buf->buffer = new_ptr;
 		buf->alloc_size = new_size;
 	}
-	memcpy(buf->buffer + buf->num_bytes, bytes, num_bytes);
+	*ret = buf->buffer + buf->num_bytes;
 	buf->num_bytes += num_bytes;
 	return 0;
 }
 
+int append_bytes(struct byte_buffer *buf, const char *bytes, size_t num_bytes)
+{
+	char *dst;
+	int ret;
+
+	if ((ret = append_space(buf, num_bytes, &dst)))
+		return ret;
+	memcpy(dst, bytes, num_bytes);
+	return 0;
+}
+
 int append_byte(struct byte_buffer *buf, char c)
 {
 	return append_bytes(buf, &c, 1);
@@ -65,22 +69,21 @@ int append_byte(struct byte_buffer *buf, char c)
 
 int encode_le(struct byte_buffer *buf, uint64_t value, size_t byte_width)
 {
-	int ret;
+	char bytes[sizeof(uint64_t)];
 	int i;
-	for (i = 0; i < byte_width; ++i) {
-		if ((ret = append_byte(buf, (uint8_t)((value >> (i * 8)) & 0xFF)))) {
-			return ret;
-		}
-	}
-	return 0;
+
+	for (i = 0; i < byte_width; ++i)
+		bytes[i] = (uint8_t)((value >> (i * 8)) & 0xFF);
+	return append_bytes(buf, bytes, byte_width);
 }
 
 int pad(struct byte_buffer *buf, size_t num_padding)
 {
+	char *dst;
 	int ret;
-	size_t i;
-	for (i = 0; i < num_padding; i++)
-		if ((ret = append_byte(buf, 0)))
-			return ret;
+
+	if ((ret = append_space(buf, num_padding, &dst)))
+		return ret;
+	memset(dst, 0, num_padding);
 	return 0;
 }
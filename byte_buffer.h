@@ -10,20 +10,42 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+#include "arena.h"
+
+/**
+ * struct byte_buffer - a growable buffer
+ *
+ * @buffer: the buffer's contents.
+ * @num_bytes: the number of bytes used.
+ * @alloc_size: the capacity of @buffer.
+ * @arena: the arena that the buffer and its contents are allocated from, so
+ *	that they are released with the arena rather than individually.
+ */
 struct byte_buffer {
 	char *buffer;
 	size_t num_bytes;
 	size_t alloc_size;
+	struct arena *arena;
 };
 
-struct byte_buffer *new_byte_buffer(size_t initial_size);
-
-void destroy_byte_buffer(struct byte_buffer *buf);
+struct byte_buffer *new_byte_buffer(struct arena *arena, size_t initial_size);
 
 int append_bytes(struct byte_buffer *buf, const char *bytes, size_t num_bytes);
 
 int append_byte(struct byte_buffer *buf, char c);
 
+/**
+ * append_space - grow a buffer by a number of uninitialized bytes
+ *
+ * @buf: the buffer.
+ * @num_bytes: number of bytes to append.
+ * @ret: set to the first appended byte, which the caller fills in. Only valid
+ *	until the buffer next grows.
+ *
+ * @return 0 on success or -ENOMEM.
+ */
+int append_space(struct byte_buffer *buf, size_t num_bytes, char **ret);
+
 int encode_le(struct byte_buffer *buf, uint64_t value, size_t byte_width);
 
 int pad(struct byte_buffer *buf, size_t num_padding);
@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Little-endian loads and stores at any alignment
+ *
+ * Copyright 2025 Google LLC
+ */
+#ifndef BYTE_ORDER_H
+#define BYTE_ORDER_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Reads a @width-byte little-endian integer, @width being at most 8. */
+static inline uint64_t load_le(const char *src, size_t width)
+{
+	uint64_t value = 0;
+	size_t i;
+
+	for (i = 0; i < width; i++)
+		value |= (uint64_t)(uint8_t)src[i] << (i * 8);
+	return value;
+}
+
+/* Writes the low @width bytes of @value in little-endian order. */
+static inline void store_le(char *dst, size_t width, uint64_t value)
+{
+	size_t i;
+
+	for (i = 0; i < width; i++)
+		dst[i] = (uint8_t)((value >> (i * 8)) & 0xFF);
+}
+
+static inline uint32_t get_le32(const char *src)
+{
+	return load_le(src, sizeof(uint32_t));
+}
+
+static inline void put_le32(char *dst, uint32_t value)
+{
+	store_le(dst, sizeof(uint32_t), value);
+}
+
+#endif /* BYTE_ORDER_H */
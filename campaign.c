@@ -0,0 +1,268 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Multi-target fuzzing campaigns with a throughput-adaptive scheduler
+ *
+ * Copyright 2025 Google LLC
+ */
+#include <asm-generic/errno-base.h>
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "arena.h"
+#include "campaign.h"
+#include "timing.h"
+#include "watchdog.h"
+
+/* Weight given to the most recent slice in the moving averages. */
+#define CAMPAIGN_EMA_ALPHA 0.3
+/* Health floor, so that targets which always fail still get probed. */
+#define CAMPAIGN_MIN_HEALTH 0.05
+
+static char *trim(char *s)
+{
+	char *end;
+
+	while (isspace((unsigned char)*s))
+		s++;
+	end = s + strlen(s);
+	while (end > s && isspace((unsigned char)end[-1]))
+		*--end = '\0';
+	return s;
+}
+
+static int add_entry(struct campaign *c, struct target_registry *reg, struct sink *sink, const char *target_name,
+		     const char *schema)
+{
+	struct campaign_entry *entry;
+	struct kfuzztest_target *t = NULL;
+	struct ast_node *ast;
+	void *new_ptr;
+	int err;
+
+	if (sink->type == SINK_DEBUGFS && !(t = registry_get(reg, target_name))) {
+		printf("campaign: no such target %s\n", target_name);
+		return -ENOENT;
+	}
+
+	new_ptr = realloc(c->entries, (c->num_entries + 1) * sizeof(struct campaign_entry *));
+	if (!new_ptr)
+		return -ENOMEM;
+	c->entries = new_ptr;
+
+	/* realloc() would not keep the worker's cache-line alignment. */
+	if (posix_memalign(&new_ptr, __alignof__(struct campaign_entry), sizeof(struct campaign_entry)))
+		return -ENOMEM;
+	entry = new_ptr;
+	*entry = (struct campaign_entry){ 0 };
+	entry->target_name = strdup(target_name);
+	entry->schema = strdup(schema);
+	if (!entry->target_name || !entry->schema) {
+		free(entry->target_name);
+		free(entry->schema);
+		free(entry);
+		return -ENOMEM;
+	}
+
+	err = compile_schema(schema, c->arena, &ast);
+	if (!err)
+		err = compile_template(ast, c->arena, &entry->tmpl);
+	if (err) {
+		printf("campaign: failed to compile schema for %s\n", target_name);
+		free(entry->target_name);
+		free(entry->schema);
+		free(entry);
+		return err;
+	}
+
+	entry->w.tmpl = entry->tmpl;
+	entry->w.target = t;
+	entry->w.sink = sink;
+	c->entries[c->num_entries++] = entry;
+	return 0;
+}
+
+int load_campaign(const char *path, struct target_registry *reg, struct sink *sink, struct campaign **ret)
+{
+	struct campaign *c;
+	size_t line_cap = 0;
+	char *line = NULL;
+	char *target;
+	char *schema;
+	size_t lineno = 0;
+	FILE *f;
+	int err = 0;
+
+	f = fopen(path, "r");
+	if (!f)
+		return -errno;
+
+	c = calloc(1, sizeof(*c));
+	if (c)
+		c->arena = new_arena(SCHEMA_ARENA_CHUNK_SIZE);
+	if (!c || !c->arena) {
+		free(c);
+		fclose(f);
+		return -ENOMEM;
+	}
+
+	while (getline(&line, &line_cap, f) >= 0) {
+		lineno++;
+		target = trim(line);
+		if (*target == '\0' || *target == '#')
+			continue;
+
+		schema = target;
+		while (*schema && !isspace((unsigned char)*schema))
+			schema++;
+		if (*schema == '\0') {
+			printf("campaign: %s:%zu: expected \"<target-name> <schema>\"\n", path, lineno);
+			err = -EINVAL;
+			break;
+		}
+		*schema++ = '\0';
+		if ((err = add_entry(c, reg, sink, target, trim(schema))))
+			break;
+	}
+	free(line);
+	fclose(f);
+
+	if (!err && c->num_entries == 0) {
+		printf("campaign: %s has no entries\n", path);
+		err = -EINVAL;
+	}
+	if (err) {
+		destroy_campaign(c);
+		return err;
+	}
+	*ret = c;
+	return 0;
+}
+
+void destroy_campaign(struct campaign *c)
+{
+	size_t i;
+
+	for (i = 0; i < c->num_entries; i++) {
+		free(c->entries[i]->target_name);
+		free(c->entries[i]->schema);
+		if (c->entries[i]->dict)
+			destroy_dictionary(c->entries[i]->dict);
+		free(c->entries[i]);
+	}
+	free(c->entries);
+	destroy_arena(c->arena);
+	free(c);
+}
+
+static double entry_weight(struct campaign_entry *e)
+{
+	double health = 1.0 - e->err_rate;
+
+	if (health < CAMPAIGN_MIN_HEALTH)
+		health = CAMPAIGN_MIN_HEALTH;
+	/* Count at least one exec per second, so that a weight is never zero. */
+	return (e->rate > 1.0 ? e->rate : 1.0) * health;
+}
+
+static struct campaign_entry *pick_entry(struct campaign *c)
+{
+	struct campaign_entry *best = NULL;
+	size_t i;
+
+	for (i = 0; i < c->num_entries; i++) {
+		/* Targets that hung are never picked again. */
+		if (c->entries[i]->w.watch && watch_quarantined(c->entries[i]->w.watch))
+			continue;
+		/* Entries that have never run are measured first. */
+		if (c->entries[i]->time_ns == 0)
+			return c->entries[i];
+		if (!best || c->entries[i]->pass < best->pass)
+			best = c->entries[i];
+	}
+	return best;
+}
+
+static void account_slice(struct campaign_entry *e, uint64_t elapsed)
+{
+	double rate;
+	double err_rate;
+
+	if (elapsed == 0)
+		elapsed = 1;
+	rate = (double)e->w.num_execs * NSEC_PER_SEC / elapsed;
+	err_rate = e->w.num_execs ? (double)e->w.num_failed / e->w.num_execs : 1.0;
+
+	if (e->time_ns == 0) {
+		e->rate = rate;
+		e->err_rate = err_rate;
+	} else {
+		e->rate += CAMPAIGN_EMA_ALPHA * (rate - e->rate);
+		e->err_rate += CAMPAIGN_EMA_ALPHA * (err_rate - e->err_rate);
+	}
+
+	e->num_execs += e->w.num_execs;
+	e->num_failed += e->w.num_failed;
+	e->time_ns += elapsed;
+	e->pass += (double)elapsed / entry_weight(e);
+}
+
+int run_campaign(struct campaign *c, struct rand_stream *rs, uint64_t first_input, uint64_t iterations,
+		 uint64_t deadline, const volatile sig_atomic_t *stop)
+{
+	struct campaign_entry *e;
+	uint64_t total_execs = 0;
+	uint64_t slice_end;
+	uint64_t start;
+	size_t i;
+	int err = 0;
+
+	for (i = 0; i < c->num_entries; i++) {
+		c->entries[i]->w.rs = rs;
+		c->entries[i]->w.stop = stop;
+		c->entries[i]->w.input_stride = 1;
+	}
+
+	while (!*stop && (!iterations || total_execs < iterations)) {
+		start = now_ns();
+		if (deadline && start >= deadline)
+			break;
+
+		e = pick_entry(c);
+		if (!e)
+			break;
+		slice_end = start + CAMPAIGN_SLICE_NS;
+		e->w.deadline = deadline && deadline < slice_end ? deadline : slice_end;
+		e->w.iterations = iterations ? iterations - total_execs : 0;
+		/* Number inputs across the whole campaign, so each is reproducible. */
+		e->w.first_input = first_input + total_execs;
+		err = worker_run(&e->w);
+
+		account_slice(e, now_ns() - start);
+		total_execs += e->w.num_execs;
+		/* Errors that a worker does not merely count end the whole campaign. */
+		if (err)
+			break;
+		/* The byte source is shared, so it is exhausted for everyone. */
+		if (e->w.exhausted)
+			break;
+	}
+	return err;
+}
+
+void print_campaign_summary(struct campaign *c)
+{
+	struct campaign_entry *e;
+	double secs;
+	size_t i;
+
+	printf("%-32s %12s %12s %12s %8s\n", "target", "execs", "failed", "execs/sec", "time");
+	for (i = 0; i < c->num_entries; i++) {
+		e = c->entries[i];
+		secs = (double)e->time_ns / NSEC_PER_SEC;
+		printf("%-32s %12llu %12llu %12.0f %7.2fs%s\n", e->target_name, (unsigned long long)e->num_execs,
+		       (unsigned long long)e->num_failed, secs > 0 ? e->num_execs / secs : 0.0, secs,
+		       e->w.watch && watch_quarantined(e->w.watch) ? " (hung)" : "");
+	}
+}
@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Multi-target fuzzing campaigns with a throughput-adaptive scheduler
+ *
+ * Copyright 2025 Google LLC
+ */
+#ifndef CAMPAIGN_H
+#define CAMPAIGN_H 1
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "dictionary.h"
+#include "kfuzztest_encoder.h"
+#include "rand_stream.h"
+#include "sink.h"
+#include "target_registry.h"
+#include "worker.h"
+
+/* Length of one scheduling slice. */
+#define CAMPAIGN_SLICE_NS 10000000ull
+
+/**
+ * struct campaign_entry - one (target, schema) pair of a campaign
+ *
+ * @dict: if set, the interesting values used for this entry's schema.
+ * @w: the worker used to run this entry's slices.
+ * @num_execs: inputs injected over the whole campaign.
+ * @num_failed: how many of those failed to encode or inject.
+ * @time_ns: time spent running this entry's slices.
+ * @rate: moving average of execs/sec over recent slices.
+ * @err_rate: moving average of the fraction of failed execs.
+ * @pass: virtual time used by the scheduler; the entry with the lowest pass
+ *	runs next.
+ */
+struct campaign_entry {
+	char *target_name;
+	char *schema;
+	struct encode_template *tmpl;
+	struct dictionary *dict;
+	struct worker w;
+
+	uint64_t num_execs;
+	uint64_t num_failed;
+	uint64_t time_ns;
+	double rate;
+	double err_rate;
+	double pass;
+};
+
+/**
+ * struct campaign - a set of targets fuzzed together
+ *
+ * @entries: one entry per target, each allocated with the alignment of its
+ *	worker.
+ * @num_entries: the number of @entries.
+ * @arena: holds the entries' compiled schemas.
+ */
+struct campaign {
+	struct campaign_entry **entries;
+	size_t num_entries;
+	struct arena *arena;
+};
+
+/**
+ * load_campaign - read and compile a campaign description
+ *
+ * @path: file listing one "<target-name> <schema>" entry per line. Empty lines
+ *	and lines starting with '#' are ignored.
+ * @reg: registry used to resolve the target names. Only used if @sink writes
+ *	to debugfs.
+ * @sink: where the entries' inputs are delivered.
+ * @ret: return pointer for the loaded campaign.
+ *
+ * Every schema is compiled exactly once, here.
+ *
+ * @return 0 on success or a negative errno on failure.
+ */
+int load_campaign(const char *path, struct target_registry *reg, struct sink *sink, struct campaign **ret);
+
+void destroy_campaign(struct campaign *c);
+
+/**
+ * run_campaign - time-slice across all of a campaign's targets
+ *
+ * @c: a loaded campaign.
+ * @rs: the byte source shared by every entry.
+ * @first_input: number of the campaign's first input, for seekable @rs.
+ * @iterations: total number of inputs to inject, or 0 for no limit.
+ * @deadline: CLOCK_MONOTONIC time in ns at which to stop, or 0 for none.
+ * @stop: set asynchronously to end the campaign.
+ *
+ * Each slice runs the entry with the lowest virtual time, which then advances
+ * in inverse proportion to the entry's weight. The weight is the entry's
+ * measured throughput scaled by its success rate, so fast and healthy targets
+ * receive most of the budget while failing targets are still probed.
+ *
+ * @return 0 on success or a negative errno on failure, such as the error
+ * that ended an entry's worker.
+ */
+int run_campaign(struct campaign *c, struct rand_stream *rs, uint64_t first_input, uint64_t iterations,
+		 uint64_t deadline, const volatile sig_atomic_t *stop);
+
+void print_campaign_summary(struct campaign *c);
+
+#endif /* CAMPAIGN_H */
@@ -0,0 +1,198 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Seed corpus directories as a source of KFuzzTest inputs
+ *
+ * Copyright 2025 Google LLC
+ */
+#include <asm-generic/errno-base.h>
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "corpus.h"
+#include "prng.h"
+
+static int compare_seeds(const void *a, const void *b)
+{
+	return strcmp(((const struct corpus_seed *)a)->path, ((const struct corpus_seed *)b)->path);
+}
+
+static int add_seed(struct corpus *c, size_t *cap, const char *dir, const char *name, size_t size)
+{
+	struct corpus_seed *seed;
+	void *new_ptr;
+
+	if (c->num_seeds == *cap) {
+		*cap = *cap ? *cap * 2 : 64;
+		new_ptr = realloc(c->seeds, *cap * sizeof(struct corpus_seed));
+		if (!new_ptr)
+			return -ENOMEM;
+		c->seeds = new_ptr;
+	}
+
+	seed = &c->seeds[c->num_seeds];
+	if (asprintf(&seed->path, "%s/%s", dir, name) < 0)
+		return -ENOMEM;
+	seed->size = size;
+	c->num_seeds++;
+	return 0;
+}
+
+static int list_seeds(struct corpus *c, const char *dir)
+{
+	struct dirent *ent;
+	size_t cap = 0;
+	struct stat st;
+	char buf[4096];
+	DIR *d;
+	int err = 0;
+
+	d = opendir(dir);
+	if (!d)
+		return -errno;
+
+	while ((ent = readdir(d))) {
+		if (ent->d_name[0] == '.')
+			continue;
+		if (snprintf(buf, sizeof(buf), "%s/%s", dir, ent->d_name) >= sizeof(buf))
+			continue;
+		if (stat(buf, &st) || !S_ISREG(st.st_mode))
+			continue;
+		if ((err = add_seed(c, &cap, dir, ent->d_name, st.st_size)))
+			break;
+	}
+	closedir(d);
+	return err;
+}
+
+int load_corpus(const char *dir, enum corpus_order order, uint64_t seed, struct corpus **ret)
+{
+	struct corpus_seed tmp;
+	struct corpus *c;
+	uint64_t total;
+	size_t i, j;
+	int err;
+
+	c = calloc(1, sizeof(*c));
+	if (!c)
+		return -ENOMEM;
+	c->order = order;
+
+	if ((err = list_seeds(c, dir)))
+		goto fail;
+	if (c->num_seeds == 0) {
+		err = -ENODATA;
+		goto fail;
+	}
+
+	/* readdir() order is arbitrary, so sort for reproducible runs. */
+	qsort(c->seeds, c->num_seeds, sizeof(struct corpus_seed), compare_seeds);
+
+	switch (order) {
+	case CORPUS_SHUFFLED:
+		for (i = c->num_seeds - 1; i > 0; i--) {
+			j = splitmix64(&seed) % (i + 1);
+			tmp = c->seeds[i];
+			c->seeds[i] = c->seeds[j];
+			c->seeds[j] = tmp;
+		}
+		break;
+	case CORPUS_WEIGHTED:
+		c->cumulative_size = malloc(c->num_seeds * sizeof(uint64_t));
+		if (!c->cumulative_size) {
+			err = -ENOMEM;
+			goto fail;
+		}
+		/* Empty seeds still get the weight of a single byte. */
+		for (i = 0, total = 0; i < c->num_seeds; i++) {
+			total += c->seeds[i].size ? c->seeds[i].size : 1;
+			c->cumulative_size[i] = total;
+		}
+		break;
+	case CORPUS_SEQUENTIAL:
+		break;
+	}
+
+	*ret = c;
+	return 0;
+
+fail:
+	destroy_corpus(c);
+	return err;
+}
+
+void destroy_corpus(struct corpus *c)
+{
+	size_t i;
+
+	for (i = 0; i < c->num_seeds; i++)
+		free(c->seeds[i].path);
+	free(c->seeds);
+	free(c->cumulative_size);
+	free(c);
+}
+
+void init_corpus_cursor(struct corpus_cursor *cur, const struct corpus *c, size_t index, size_t count,
+			uint64_t seed)
+{
+	cur->corpus = c;
+	cur->start = index;
+	cur->pos = index;
+	cur->stride = count;
+	cur->rng = seed + index;
+}
+
+static size_t draw_weighted(struct corpus_cursor *cur)
+{
+	const struct corpus *c = cur->corpus;
+	uint64_t target = splitmix64(&cur->rng) % c->cumulative_size[c->num_seeds - 1];
+	size_t lo = 0;
+	size_t hi = c->num_seeds - 1;
+	size_t mid;
+
+	/* Find the first seed whose cumulative size exceeds target. */
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (c->cumulative_size[mid] > target)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return lo;
+}
+
+int corpus_next(struct corpus_cursor *cur, struct rand_stream **rs_ret)
+{
+	const struct corpus *c = cur->corpus;
+	struct rand_stream *rs;
+	size_t idx;
+
+	if (cur->start >= c->num_seeds)
+		return -ENODATA;
+	if (cur->pos >= c->num_seeds)
+		cur->pos = cur->start;
+	idx = c->order == CORPUS_WEIGHTED ? draw_weighted(cur) : cur->pos;
+	cur->pos += cur->stride;
+
+	/* Seeds shorter than the schema are padded with zero bytes. */
+	rs = new_mmap_rand_stream(c->seeds[idx].path, true);
+	if (!rs)
+		return errno ? -errno : -ENOMEM;
+	*rs_ret = rs;
+	return 0;
+}
+
+int parse_corpus_order(const char *name, enum corpus_order *ret)
+{
+	if (strcmp(name, "sequential") == 0)
+		*ret = CORPUS_SEQUENTIAL;
+	else if (strcmp(name, "shuffled") == 0 || strcmp(name, "shuffle") == 0)
+		*ret = CORPUS_SHUFFLED;
+	else if (strcmp(name, "weighted") == 0)
+		*ret = CORPUS_WEIGHTED;
+	else
+		return -EINVAL;
+	return 0;
+}
@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Seed corpus directories as a source of KFuzzTest inputs
+ *
+ * Copyright 2025 Google LLC
+ */
+#ifndef CORPUS_H
+#define CORPUS_H 1
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "rand_stream.h"
+
+enum corpus_order {
+	CORPUS_SEQUENTIAL,
+	CORPUS_SHUFFLED,
+	CORPUS_WEIGHTED,
+};
+
+struct corpus_seed {
+	char *path;
+	size_t size;
+};
+
+/**
+ * struct corpus - the seed files found in a directory
+ *
+ * @seeds: the seeds, in iteration order for CORPUS_SEQUENTIAL and
+ *	CORPUS_SHUFFLED.
+ * @cumulative_size: prefix sums of the seed sizes, used to draw seeds with
+ *	probability proportional to their size for CORPUS_WEIGHTED.
+ *
+ * A corpus is never modified after load_corpus(), so it can be shared by
+ * several workers, each iterating through it with its own struct
+ * corpus_cursor.
+ */
+struct corpus {
+	struct corpus_seed *seeds;
+	size_t num_seeds;
+	uint64_t *cumulative_size;
+	enum corpus_order order;
+};
+
+/**
+ * struct corpus_cursor - one worker's position in a corpus
+ *
+ * Each of @stride cursors cycles through a disjoint subset of the seeds,
+ * starting at seed @start. A weighted cursor draws seeds at random instead.
+ */
+struct corpus_cursor {
+	const struct corpus *corpus;
+	size_t start;
+	size_t pos;
+	size_t stride;
+	uint64_t rng;
+};
+
+/**
+ * load_corpus - list the seed files in a directory
+ *
+ * @dir: directory holding one seed per regular file.
+ * @order: order in which cursors visit the seeds.
+ * @seed: seed for the shuffle of CORPUS_SHUFFLED.
+ * @ret: return pointer for the corpus.
+ *
+ * @return 0 on success or a negative errno on failure.
+ */
+int load_corpus(const char *dir, enum corpus_order order, uint64_t seed, struct corpus **ret);
+
+void destroy_corpus(struct corpus *c);
+
+/**
+ * init_corpus_cursor - set up the @index-th of @count cursors over a corpus
+ */
+void init_corpus_cursor(struct corpus_cursor *cur, const struct corpus *c, size_t index, size_t count,
+			uint64_t seed);
+
+/**
+ * corpus_next - map the cursor's next seed
+ *
+ * @cur: an initialized cursor.
+ * @rs_ret: return pointer for a zero-padded rand_stream serving the seed's
+ *	bytes directly from its mapping. Must be released with
+ *	destroy_rand_stream().
+ *
+ * Once the cursor has been through its share of the corpus, it starts over.
+ *
+ * @return 0 on success, -ENODATA if the cursor's share is empty, or another
+ * negative errno on failure.
+ */
+int corpus_next(struct corpus_cursor *cur, struct rand_stream **rs_ret);
+
+int parse_corpus_order(const char *name, enum corpus_order *ret);
+
+#endif /* CORPUS_H */
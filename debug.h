@@ -74,7 +74,12 @@ static void visualize_node(struct ast_node *node, int indent)
 	}
 	case NODE_ARRAY: {
 		struct ast_array *arr = &node->data.array;
-		printf("array (num_elems: %zu, width: %d))\n", arr->num_elems, arr->elem_size);
+		printf("array (num_elems: %zu..%zu, width: %d))\n", arr->min_elems, arr->num_elems, arr->elem_size);
+		break;
+	}
+	case NODE_LEN: {
+		struct ast_len *len = &node->data.len;
+		printf("Length of '%s' (width: %d)\n", len->target, len->byte_width);
 		break;
 	}
 	// Add cases for NODE_ARRAY etc. as you implement them
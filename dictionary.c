@@ -0,0 +1,274 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Dictionaries of interesting values for primitive fields
+ *
+ * Copyright 2025 Google LLC
+ */
+#include <asm-generic/errno-base.h>
+#include <ctype.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "byte_order.h"
+#include "dictionary.h"
+
+/* Values that tend to sit on either side of a bounds check. */
+static const int64_t builtin_values[] = {
+	0, 1, 2, 3, 4, 7, 8, 10, 15, 16, 31, 32, 63, 64, 100, 127, 128, 255, 256, 512, 1000, 1023, 1024,
+	/* Page and huge page sizes. */
+	4095, 4096, 4097, 8192, 0x200000, 0x40000000,
+	/* Limits of every width. */
+	32767, 32768, 65535, 65536, 0x7fffffff, 0x80000000, 0xffffffff, 0x100000000, INT64_MAX,
+	-1, -2, -16, -128, -129, -32768, -32769, INT32_MIN, (int64_t)INT32_MIN - 1, INT64_MIN,
+};
+
+static int width_index(size_t width)
+{
+	switch (width) {
+	case 1:
+		return 0;
+	case 2:
+		return 1;
+	case 4:
+		return 2;
+	case 8:
+		return 3;
+	}
+	return -1;
+}
+
+static int push_value(struct dictionary *d, int i, uint64_t value)
+{
+	size_t new_alloc;
+	void *new_ptr;
+
+	if (d->num_values[i] == d->alloc_values[i]) {
+		new_alloc = d->alloc_values[i] ? 2 * d->alloc_values[i] : 64;
+		new_ptr = realloc(d->values[i], new_alloc * sizeof(uint64_t));
+		if (!new_ptr)
+			return -ENOMEM;
+		d->values[i] = new_ptr;
+		d->alloc_values[i] = new_alloc;
+	}
+	d->values[i][d->num_values[i]++] = value;
+	return 0;
+}
+
+/* Adds @value to every width it fits, as an unsigned integer or, if @is_signed, as a signed one. */
+static int add_value(struct dictionary *d, uint64_t value, bool is_signed)
+{
+	unsigned int bits;
+	uint64_t mask;
+	int err;
+	int i;
+
+	for (i = 0; i < DICTIONARY_NUM_WIDTHS; i++) {
+		bits = 8 << i;
+		mask = bits == 64 ? UINT64_MAX : (1ull << bits) - 1;
+		if (bits < 64 && value > mask &&
+		    !(is_signed && (int64_t)value >= -(int64_t)(1ull << (bits - 1))))
+			continue;
+		if ((err = push_value(d, i, value & mask)))
+			return err;
+	}
+	return 0;
+}
+
+/* Adds @value and its neighbours, e.g. a size that may be off by one. */
+static int add_neighbours(struct dictionary *d, uint64_t value)
+{
+	int err;
+
+	if (value && (err = add_value(d, value - 1, false)))
+		return err;
+	if ((err = add_value(d, value, false)))
+		return err;
+	return add_value(d, value + 1, false);
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Sorts the values of every width and drops duplicates. */
+static void finish(struct dictionary *d)
+{
+	size_t n, j;
+	int i;
+
+	for (i = 0; i < DICTIONARY_NUM_WIDTHS; i++) {
+		if (!d->num_values[i])
+			continue;
+		qsort(d->values[i], d->num_values[i], sizeof(uint64_t), compare_u64);
+		for (n = 1, j = 1; j < d->num_values[i]; j++) {
+			if (d->values[i][j] != d->values[i][n - 1])
+				d->values[i][n++] = d->values[i][j];
+		}
+		d->num_values[i] = n;
+	}
+}
+
+static int load_file(struct dictionary *d, const char *path)
+{
+	size_t line_cap = 0;
+	char *line = NULL;
+	size_t lineno = 0;
+	uint64_t value;
+	char *s, *end;
+	int err = 0;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f)
+		return -errno;
+
+	while (getline(&line, &line_cap, f) >= 0) {
+		lineno++;
+		for (s = line; isspace((unsigned char)*s); s++)
+			;
+		if (*s == '\0' || *s == '#')
+			continue;
+
+		errno = 0;
+		value = *s == '-' ? (uint64_t)strtoll(s, &end, 0) : strtoull(s, &end, 0);
+		while (isspace((unsigned char)*end))
+			end++;
+		if (errno || end == s || *end != '\0') {
+			printf("dictionary: %s:%zu: expected an integer\n", path, lineno);
+			err = -EINVAL;
+			break;
+		}
+		if ((err = add_value(d, value, *s == '-')))
+			break;
+	}
+	free(line);
+	fclose(f);
+	return err;
+}
+
+int load_dictionary(const char *path, struct dictionary **ret)
+{
+	struct dictionary *d;
+	int err = 0;
+	size_t i;
+	int k;
+
+	d = calloc(1, sizeof(*d));
+	if (!d)
+		return -ENOMEM;
+
+	for (i = 0; !err && i < sizeof(builtin_values) / sizeof(builtin_values[0]); i++)
+		err = add_value(d, builtin_values[i], builtin_values[i] < 0);
+	/* Every power of two is a likely limit, and its neighbours the values just past it. */
+	for (k = 0; !err && k < 64; k++)
+		err = add_neighbours(d, 1ull << k);
+	if (!err && path)
+		err = load_file(d, path);
+	if (err) {
+		destroy_dictionary(d);
+		return err;
+	}
+
+	finish(d);
+	*ret = d;
+	return 0;
+}
+
+int dictionary_for_template(const struct dictionary *base, const struct encode_template *t,
+			    struct dictionary **ret)
+{
+	const struct ast_node *node;
+	struct dictionary *d;
+	int err = 0;
+	size_t j;
+	int i;
+
+	d = calloc(1, sizeof(*d));
+	if (!d)
+		return -ENOMEM;
+
+	for (i = 0; !err && i < DICTIONARY_NUM_WIDTHS; i++) {
+		for (j = 0; !err && j < base->num_values[i]; j++)
+			err = push_value(d, i, base->values[i][j]);
+	}
+	for (j = 0; !err && j < t->prog->num_members; j++)
+		err = add_neighbours(d, node_size(t->prog->members[j]));
+	for (j = 0; !err && j < t->num_fields; j++) {
+		node = t->fields[j].node;
+		if (node->type != NODE_ARRAY)
+			continue;
+		if (!(err = add_neighbours(d, node->data.array.num_elems)))
+			err = add_neighbours(d, t->fields[j].span.len);
+		/* A ranged array's fields are at its largest, so add its smallest too. */
+		if (!err && node->data.array.min_elems != node->data.array.num_elems &&
+		    !(err = add_neighbours(d, node->data.array.min_elems)))
+			err = add_neighbours(d, node->data.array.min_elems * node->data.array.elem_size);
+	}
+	if (err) {
+		destroy_dictionary(d);
+		return err;
+	}
+
+	finish(d);
+	*ret = d;
+	return 0;
+}
+
+void destroy_dictionary(struct dictionary *d)
+{
+	int i;
+
+	for (i = 0; i < DICTIONARY_NUM_WIDTHS; i++)
+		free(d->values[i]);
+	free(d);
+}
+
+uint64_t dictionary_pick(const struct dictionary *d, size_t width, uint64_t bits)
+{
+	int i = width_index(width);
+
+	if (i < 0 || !d->num_values[i])
+		return bits;
+	return d->values[i][bits % d->num_values[i]];
+}
+
+int dictionary_fill(const struct dictionary *d, const struct encode_template *t, const struct template_field *fields,
+		    struct rand_stream *r, struct provenance *prov, char *buf)
+{
+	const struct template_field *field;
+	struct provenance_entry entry;
+	char choice[DICTIONARY_CHOICE_SIZE];
+	uint64_t bits;
+	size_t i;
+	int err;
+
+	for (i = 0; i < t->num_fields; i++) {
+		field = &fields[i];
+		if (field->node->type != NODE_PRIMITIVE)
+			continue;
+		entry = (struct provenance_entry){
+			.src_offset = r->offset,
+			.src_len = sizeof(choice),
+			.region = t->prog->members[field->region]->data.region.name,
+			.member = field->member,
+			.field = field->node,
+			.payload_offset = field->span.offset - t->payload_offset,
+			.choice = true,
+		};
+		if (prov && (err = provenance_add(prov, entry)))
+			return err;
+		if ((err = next_bytes(r, choice, sizeof(choice))))
+			return err;
+		bits = load_le(choice, sizeof(choice));
+		if (bits % DICTIONARY_CHANCE == 0)
+			store_le(buf + field->span.offset, field->span.len,
+				 dictionary_pick(d, field->span.len, bits / DICTIONARY_CHANCE));
+	}
+	return 0;
+}
@@ -0,0 +1,109 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Dictionaries of interesting values for primitive fields
+ *
+ * Copyright 2025 Google LLC
+ */
+#ifndef DICTIONARY_H
+#define DICTIONARY_H 1
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "kfuzztest_encoder.h"
+
+/* Number of primitive widths: 1, 2, 4 and 8 bytes. */
+#define DICTIONARY_NUM_WIDTHS 4
+
+/* One primitive in this many is replaced with an interesting value. */
+#define DICTIONARY_CHANCE 4
+
+/* Bytes drawn from the byte source for every primitive, to choose its value. */
+#define DICTIONARY_CHOICE_SIZE 4
+
+/**
+ * struct dictionary - interesting values, by primitive width
+ *
+ * @values: for each width, in increasing order of size, the distinct values
+ *	that fit it, truncated to the width.
+ * @num_values: the number of values of each width.
+ * @alloc_values: the capacity of each of @values.
+ *
+ * A dictionary is never modified once built, so it can be shared by several
+ * workers.
+ */
+struct dictionary {
+	uint64_t *values[DICTIONARY_NUM_WIDTHS];
+	size_t num_values[DICTIONARY_NUM_WIDTHS];
+	size_t alloc_values[DICTIONARY_NUM_WIDTHS];
+};
+
+/**
+ * load_dictionary - build a dictionary of boundary values
+ *
+ * @path: if set, a file of extra values, one per line, in decimal (possibly
+ *	negative) or hexadecimal with a 0x prefix. Blank lines and lines
+ *	starting with '#' are ignored.
+ * @ret: return pointer for the dictionary.
+ *
+ * The dictionary holds 0, small integers, powers of two and their neighbours,
+ * the signed and unsigned limits of every width, page sizes and the values
+ * of @path. Each value is added to every width it fits, either as an unsigned
+ * integer or, if negative, as a signed one.
+ *
+ * @return 0 on success or a negative errno on failure, in which case a
+ * malformed line of @path is reported on stdout.
+ */
+int load_dictionary(const char *path, struct dictionary **ret);
+
+/**
+ * dictionary_for_template - extend a dictionary with a schema's sizes
+ *
+ * @base: the dictionary to extend, which is left untouched.
+ * @t: the schema's template.
+ * @ret: return pointer for a new dictionary holding the values of @base, and
+ *	the sizes of @t's regions and arrays, in bytes and in elements, along
+ *	with their neighbours. Ranged arrays add both of their bounds.
+ *
+ * @return 0 on success or a negative errno on failure.
+ */
+int dictionary_for_template(const struct dictionary *base, const struct encode_template *t,
+			    struct dictionary **ret);
+
+void destroy_dictionary(struct dictionary *d);
+
+/**
+ * dictionary_pick - map random bits to an interesting value
+ *
+ * @d: the dictionary.
+ * @width: the width of the value in bytes: 1, 2, 4 or 8.
+ * @bits: random bits that select the value.
+ *
+ * @return the selected value, or @bits if @d has no value of this width.
+ */
+uint64_t dictionary_pick(const struct dictionary *d, size_t width, uint64_t bits);
+
+/**
+ * dictionary_fill - mix interesting values into the primitives of an input
+ *
+ * @d: the dictionary.
+ * @t: the input's template.
+ * @fields: where the primitives and arrays of the input are: @t's fields, or
+ *	for schemas with ranged arrays, those of the input itself.
+ * @r: the byte source the input was encoded from.
+ * @prov: if set, the input's provenance, which gains a choice entry for every
+ *	primitive.
+ * @buf: the input, whose fields hold bytes drawn from @r.
+ *
+ * For every primitive field, DICTIONARY_CHOICE_SIZE more bytes are drawn from
+ * @r, which replace the field with an interesting value of its width with a
+ * chance of 1 in DICTIONARY_CHANCE, and select that value. The bytes the
+ * field holds are left alone otherwise, so that every value of the field
+ * remains possible, and the input stays a pure function of the bytes drawn.
+ *
+ * @return 0 on success or a negative errno if @r ran out of bytes.
+ */
+int dictionary_fill(const struct dictionary *d, const struct encode_template *t, const struct template_field *fields,
+		    struct rand_stream *r, struct provenance *prov, char *buf);
+
+#endif /* DICTIONARY_H */
@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Futex-based handoff between the two sides of a single-producer,
+ * single-consumer ring
+ *
+ * Copyright 2025 Google LLC
+ */
+#ifndef HANDOFF_H
+#define HANDOFF_H 1
+
+#include <linux/futex.h>
+#include <stdint.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static inline void futex_wait(uint32_t *addr, uint32_t val)
+{
+	syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+static inline void futex_wake(uint32_t *addr)
+{
+	syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+/*
+ * Waits until *@counter differs from @val. The waiter announces itself in
+ * *@waiting before checking *@counter a last time, and the other side bumps
+ * the counter before checking *@waiting, so one of them always sees the other.
+ */
+static inline void wait_for_change(uint32_t *counter, uint32_t val, uint32_t *waiting)
+{
+	while (__atomic_load_n(counter, __ATOMIC_ACQUIRE) == val) {
+		__atomic_store_n(waiting, 1, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(counter, __ATOMIC_SEQ_CST) == val)
+			futex_wait(counter, val);
+		__atomic_store_n(waiting, 0, __ATOMIC_RELAXED);
+	}
+}
+
+/* Increments *@counter, which only the caller writes, and wakes the other side if it waits on it. */
+static inline void bump(uint32_t *counter, uint32_t *waiting)
+{
+	__atomic_store_n(counter, *counter + 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(waiting, __ATOMIC_SEQ_CST))
+		futex_wake(counter);
+}
+
+#endif /* HANDOFF_H */
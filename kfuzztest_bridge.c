@@ -5,97 +5,832 @@
  * Copyright 2025 Google LLC
  */
 #include <asm-generic/errno-base.h>
-#include <fcntl.h>
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+#include "arena.h"
 #include "byte_buffer.h"
+#include "campaign.h"
+#include "corpus.h"
+#include "dictionary.h"
 #include "kfuzztest_encoder.h"
 #include "kfuzztest_input_lexer.h"
 #include "kfuzztest_input_parser.h"
+#include "mutator.h"
+#include "provenance.h"
 #include "rand_stream.h"
+#include "server.h"
+#include "shm_ring.h"
+#include "sink.h"
+#include "stats.h"
+#include "target_registry.h"
+#include "timing.h"
+#include "uring_backend.h"
+#include "watchdog.h"
+#include "worker.h"
+
+#define STR_(x) #x
+#define STR(x) STR_(x)
 
 const char *usage_str = "usage: "
-			"./kfuzztest-bridge <program-description> <fuzz-target-name> <input-file>\n"
+			"./kfuzztest-bridge [options] <program-description> <fuzz-target-name> <input-file|corpus-dir>\n"
+			"       ./kfuzztest-bridge [options] --prng[=<seed>] <program-description> <fuzz-target-name>\n"
+			"       ./kfuzztest-bridge [options] --campaign <file> <input-file>\n"
+			"       ./kfuzztest-bridge [options] --shm-ring <file> <program-description> <fuzz-target-name>\n"
+			"       ./kfuzztest-bridge [options] --serve <socket>\n"
+			"options:\n"
+			"  -n, --iterations <N>    encode and inject N inputs (default 1)\n"
+			"  -t, --duration <secs>   stop after the given number of seconds\n"
+			"  -F, --forever           run until the input is exhausted or interrupted\n"
+			"  -r, --debugfs-root <dir> directory containing the KFuzzTest targets\n"
+			"                          (default " KFUZZTEST_DEBUGFS_ROOT ")\n"
+			"  -l, --list-targets      print the discovered targets and exit\n"
+			"  -j, --jobs <N>          run N workers in parallel (default 1)\n"
+			"  -U, --io-uring[=<depth>] inject inputs in batches through io_uring\n"
+			"                          (default depth " STR(URING_DEFAULT_DEPTH) ")\n"
+			"  -P, --pipeline[=<depth>] encode on the worker threads and inject from a\n"
+			"                          separate thread, <depth> inputs apart (default "
+			STR(PIPELINE_DEFAULT_DEPTH) ")\n"
+			"      --corpus-order <order> sequential (default), shuffled or weighted\n"
+			"      --read-ahead[=<N>]  read the input file from a background thread into N\n"
+			"                          buffers (default " STR(RAND_STREAM_READ_AHEAD_DEPTH) ")\n"
+			"      --read-buffer <bytes> size of each input file buffer\n"
+			"  -R, --prng[=<seed>]     generate input bytes from a seeded PRNG instead of a file\n"
+			"      --first-input <N>   number of the first PRNG input, to replay a run from it\n"
+			"  -M, --mutate[=<N>]      follow each encoded input with N inputs that mutate\n"
+			"                          the previous one in place (default " STR(MUTATE_DEFAULT_INPUTS) ")\n"
+			"  -I, --interesting[=<dict>] mix interesting values into primitive fields,\n"
+			"                          adding those listed in the file <dict>\n"
+			"  -o, --output <file>     append length-prefixed inputs to <file> (- for stdout)\n"
+			"                          instead of injecting them\n"
+			"      --discard           encode inputs but discard them\n"
+			"      --receive[=<harness.so>] decode and check inputs in-process instead of\n"
+			"                          injecting them, running the harness on each\n"
+			"  -c, --campaign <file>   fuzz every \"<target> <schema>\" line of <file>\n"
+			"      --shm-ring <file>   encode inputs in place from a shared-memory ring\n"
+			"  -S, --serve <socket>    serve encode-and-inject requests on a Unix socket\n"
+			"  -W, --watchdog <ms>     treat writes taking longer than <ms> as hangs\n"
+			"      --hang-dir <dir>    where inputs that hung are saved (default .)\n"
+			"      --provenance <file> log which source bytes filled each field of every input\n"
+			"  -s, --stats-file <file> periodically dump execution statistics to <file>\n"
+			"      --stats-format <fmt> json (default) or prometheus\n"
+			"      --stats-interval <secs> time between dumps (default 10)\n"
 			"for more detailed information see <docs>";
 
-static int invoke_one(const char *input_fmt, const char *fuzz_target, const char *input_filepath);
+/**
+ * struct bridge_opts - command-line configuration of the bridge
+ *
+ * @iterations: number of inputs to inject, or 0 for no limit.
+ * @iterations_set: whether @iterations was given explicitly.
+ * @duration: wall-clock limit in seconds, or 0 for no limit.
+ * @debugfs_root: directory holding one subdirectory per fuzz target.
+ * @jobs: number of concurrent workers.
+ * @campaign_path: campaign description to run instead of a single target.
+ * @uring_depth: io_uring depth per worker, or 0 for synchronous writes.
+ * @pipeline_depth: number of buffers between each worker and the injector
+ *	thread, or 0 for workers to inject their own inputs.
+ * @serve_path: Unix socket on which to serve requests instead of fuzzing.
+ * @shm_path: shared-memory ring to take inputs from instead of @input_filepath.
+ * @prng: generate input bytes instead of reading @input_filepath.
+ * @prng_seed: the generator's seed.
+ * @first_input: number of the first generated input.
+ * @mutate_inputs: number of mutated inputs following each encoded one, or 0
+ *	to encode every input afresh.
+ * @interesting: mix interesting values into primitive fields.
+ * @dictionary_path: if set, a file of extra interesting values.
+ * @read_ahead: number of buffers that a background thread reads
+ *	@input_filepath into, or 0 to read it synchronously.
+ * @read_buffer: size of the buffers @input_filepath is read into, or 0 for
+ *	the default.
+ * @provenance_path: if set, log the provenance of every input's fields here.
+ * @stats_path: file to which statistics are dumped, or NULL.
+ * @watchdog_ms: per-write timeout, or 0 to disable the watchdog.
+ * @hang_dir: directory in which the watchdog saves inputs that hung.
+ * @sink_type: where encoded inputs are delivered.
+ * @output_path: output file of a SINK_FILE sink, or harness of a
+ *	SINK_RECEIVER sink.
+ */
+struct bridge_opts {
+	const char *input_fmt;
+	const char *fuzz_target;
+	const char *input_filepath;
+	uint64_t iterations;
+	bool iterations_set;
+	uint64_t duration;
+	const char *debugfs_root;
+	bool list_targets;
+	uint64_t jobs;
+	const char *campaign_path;
+	uint64_t uring_depth;
+	uint64_t pipeline_depth;
+	const char *serve_path;
+	const char *shm_path;
+	bool prng;
+	uint64_t prng_seed;
+	uint64_t first_input;
+	uint64_t mutate_inputs;
+	bool interesting;
+	const char *dictionary_path;
+	uint64_t read_ahead;
+	uint64_t read_buffer;
+	const char *provenance_path;
+	const char *stats_path;
+	enum stats_format stats_format;
+	uint64_t stats_interval;
+	enum corpus_order corpus_order;
+	enum sink_type sink_type;
+	const char *output_path;
+	uint64_t watchdog_ms;
+	const char *hang_dir;
+};
+
+enum {
+	OPT_STATS_FORMAT = 256,
+	OPT_STATS_INTERVAL,
+	OPT_CORPUS_ORDER,
+	OPT_DISCARD,
+	OPT_RECEIVE,
+	OPT_SHM_RING,
+	OPT_HANG_DIR,
+	OPT_FIRST_INPUT,
+	OPT_PROVENANCE,
+	OPT_READ_AHEAD,
+	OPT_READ_BUFFER,
+};
+
+static volatile sig_atomic_t stop_requested;
+
+static void handle_stop(int sig)
+{
+	stop_requested = 1;
+}
+
+static int invoke_loop(struct bridge_opts *opts, struct target_registry *reg, struct sink *sink,
+		       struct stats_collector *sc, struct watchdog *wd, struct provenance_log *plog);
+static int invoke_campaign(struct bridge_opts *opts, struct target_registry *reg, struct sink *sink,
+			   struct stats_collector *sc, struct watchdog *wd, struct provenance_log *plog);
+
+static int parse_u64(const char *s, uint64_t *ret)
+{
+	char *end;
+
+	errno = 0;
+	*ret = strtoull(s, &end, 10);
+	if (errno || *s == '\0' || *end != '\0')
+		return -EINVAL;
+	return 0;
+}
+
+static int parse_opts(int argc, char *argv[], struct bridge_opts *opts)
+{
+	static const struct option long_opts[] = {
+		{ "iterations", required_argument, NULL, 'n' },
+		{ "duration", required_argument, NULL, 't' },
+		{ "forever", no_argument, NULL, 'F' },
+		{ "debugfs-root", required_argument, NULL, 'r' },
+		{ "list-targets", no_argument, NULL, 'l' },
+		{ "jobs", required_argument, NULL, 'j' },
+		{ "campaign", required_argument, NULL, 'c' },
+		{ "io-uring", optional_argument, NULL, 'U' },
+		{ "pipeline", optional_argument, NULL, 'P' },
+		{ "serve", required_argument, NULL, 'S' },
+		{ "shm-ring", required_argument, NULL, OPT_SHM_RING },
+		{ "watchdog", required_argument, NULL, 'W' },
+		{ "hang-dir", required_argument, NULL, OPT_HANG_DIR },
+		{ "provenance", required_argument, NULL, OPT_PROVENANCE },
+		{ "stats-file", required_argument, NULL, 's' },
+		{ "stats-format", required_argument, NULL, OPT_STATS_FORMAT },
+		{ "stats-interval", required_argument, NULL, OPT_STATS_INTERVAL },
+		{ "corpus-order", required_argument, NULL, OPT_CORPUS_ORDER },
+		{ "prng", optional_argument, NULL, 'R' },
+		{ "first-input", required_argument, NULL, OPT_FIRST_INPUT },
+		{ "mutate", optional_argument, NULL, 'M' },
+		{ "interesting", optional_argument, NULL, 'I' },
+		{ "read-ahead", optional_argument, NULL, OPT_READ_AHEAD },
+		{ "read-buffer", required_argument, NULL, OPT_READ_BUFFER },
+		{ "output", required_argument, NULL, 'o' },
+		{ "discard", no_argument, NULL, OPT_DISCARD },
+		{ "receive", optional_argument, NULL, OPT_RECEIVE },
+		{ NULL, 0, NULL, 0 },
+	};
+	int c;
+
+	*opts = (struct bridge_opts){ .iterations = 1, .jobs = 1, .stats_interval = 10, .hang_dir = "." };
+	while ((c = getopt_long(argc, argv, "n:t:Fr:lj:c:U::P::S:s:o:W:R::M::I::", long_opts, NULL)) != -1) {
+		switch (c) {
+		case 'n':
+			if (parse_u64(optarg, &opts->iterations))
+				return -EINVAL;
+			opts->iterations_set = true;
+			break;
+		case 't':
+			if (parse_u64(optarg, &opts->duration))
+				return -EINVAL;
+			break;
+		case 'F':
+			opts->iterations = 0;
+			opts->iterations_set = true;
+			break;
+		case 'r':
+			opts->debugfs_root = optarg;
+			break;
+		case 'l':
+			opts->list_targets = true;
+			break;
+		case 'j':
+			if (parse_u64(optarg, &opts->jobs) || opts->jobs == 0)
+				return -EINVAL;
+			break;
+		case 'c':
+			opts->campaign_path = optarg;
+			break;
+		case 'U':
+			opts->uring_depth = URING_DEFAULT_DEPTH;
+			if (optarg && (parse_u64(optarg, &opts->uring_depth) || opts->uring_depth == 0 ||
+				       opts->uring_depth > 4096))
+				return -EINVAL;
+			break;
+		case 'P':
+			opts->pipeline_depth = PIPELINE_DEFAULT_DEPTH;
+			if (optarg && (parse_u64(optarg, &opts->pipeline_depth) || opts->pipeline_depth == 0 ||
+				       opts->pipeline_depth > 4096))
+				return -EINVAL;
+			break;
+		case 'S':
+			opts->serve_path = optarg;
+			break;
+		case 'R':
+			opts->prng = true;
+			/* Without an explicit seed, pick one; it is logged so the run can be replayed. */
+			opts->prng_seed = now_ns() ^ ((uint64_t)getpid() << 32);
+			if (optarg && parse_u64(optarg, &opts->prng_seed))
+				return -EINVAL;
+			break;
+		case 'M':
+			opts->mutate_inputs = MUTATE_DEFAULT_INPUTS;
+			if (optarg && (parse_u64(optarg, &opts->mutate_inputs) || opts->mutate_inputs == 0))
+				return -EINVAL;
+			break;
+		case 'I':
+			opts->interesting = true;
+			opts->dictionary_path = optarg;
+			break;
+		case OPT_FIRST_INPUT:
+			if (parse_u64(optarg, &opts->first_input))
+				return -EINVAL;
+			break;
+		case OPT_SHM_RING:
+			opts->shm_path = optarg;
+			break;
+		case 'W':
+			if (parse_u64(optarg, &opts->watchdog_ms) || opts->watchdog_ms == 0)
+				return -EINVAL;
+			break;
+		case OPT_READ_AHEAD:
+			opts->read_ahead = RAND_STREAM_READ_AHEAD_DEPTH;
+			if (optarg && (parse_u64(optarg, &opts->read_ahead) || opts->read_ahead < 2 ||
+				       opts->read_ahead > 4096))
+				return -EINVAL;
+			break;
+		case OPT_READ_BUFFER:
+			if (parse_u64(optarg, &opts->read_buffer) || opts->read_buffer == 0)
+				return -EINVAL;
+			break;
+		case OPT_PROVENANCE:
+			opts->provenance_path = optarg;
+			break;
+		case OPT_HANG_DIR:
+			opts->hang_dir = optarg;
+			break;
+		case 's':
+			opts->stats_path = optarg;
+			break;
+		case OPT_STATS_FORMAT:
+			if (parse_stats_format(optarg, &opts->stats_format))
+				return -EINVAL;
+			break;
+		case OPT_CORPUS_ORDER:
+			if (parse_corpus_order(optarg, &opts->corpus_order))
+				return -EINVAL;
+			break;
+		case 'o':
+			if (opts->sink_type != SINK_DEBUGFS)
+				return -EINVAL;
+			opts->sink_type = SINK_FILE;
+			opts->output_path = optarg;
+			break;
+		case OPT_DISCARD:
+			if (opts->sink_type != SINK_DEBUGFS)
+				return -EINVAL;
+			opts->sink_type = SINK_NULL;
+			break;
+		case OPT_RECEIVE:
+			if (opts->sink_type != SINK_DEBUGFS)
+				return -EINVAL;
+			opts->sink_type = SINK_RECEIVER;
+			opts->output_path = optarg;
+			break;
+		case OPT_STATS_INTERVAL:
+			if (parse_u64(optarg, &opts->stats_interval) || opts->stats_interval == 0)
+				return -EINVAL;
+			break;
+		default:
+			return -EINVAL;
+		}
+	}
+
+	/*
+	 * A duration without an explicit count runs until the deadline. With
+	 * both, whichever limit is reached first stops the run.
+	 */
+	if (opts->duration && !opts->iterations_set) {
+		opts->iterations = 0;
+		opts->iterations_set = true;
+	}
+
+	if (opts->list_targets)
+		return argc == optind ? 0 : -EINVAL;
+	/* io_uring writes straight to the target's debugfs file. */
+	if (opts->uring_depth && opts->sink_type != SINK_DEBUGFS)
+		return -EINVAL;
+	/* Mutations are not attributed to source bytes, and need a byte source of their own. */
+	if (opts->mutate_inputs && (opts->provenance_path || opts->serve_path || opts->shm_path))
+		return -EINVAL;
+	/* Shared-memory and server inputs are taken as they are. */
+	if (opts->interesting && (opts->serve_path || opts->shm_path))
+		return -EINVAL;
+	/*
+	 * A pipeline's injector makes synchronous writes for every worker of a
+	 * single target, while shared-memory slots must be completed by the
+	 * thread that took them.
+	 */
+	if (opts->pipeline_depth &&
+	    (opts->uring_depth || opts->serve_path || opts->shm_path || opts->campaign_path))
+		return -EINVAL;
+	/* The watchdog only sees synchronous writes made by workers. */
+	if (opts->watchdog_ms && (opts->uring_depth || opts->serve_path))
+		return -EINVAL;
+	if (opts->serve_path) {
+		/* Inputs arrive over the socket, one request at a time. */
+		if (argc != optind || opts->campaign_path || opts->shm_path || opts->jobs != 1 || opts->uring_depth ||
+		    opts->stats_path || opts->provenance_path)
+			return -EINVAL;
+		return 0;
+	}
+	if (opts->shm_path) {
+		/*
+		 * The ring has a single consumer, which reports every outcome
+		 * before releasing the slot, so writes must be synchronous.
+		 */
+		if (argc - optind != 2 || opts->campaign_path || opts->prng || opts->jobs != 1 || opts->uring_depth)
+			return -EINVAL;
+		opts->input_fmt = argv[optind];
+		opts->fuzz_target = argv[optind + 1];
+		return 0;
+	}
+	if (opts->campaign_path) {
+		/* Campaigns time-slice a single thread across their targets. */
+		if (argc - optind != (opts->prng ? 0 : 1) || opts->jobs != 1)
+			return -EINVAL;
+		if (!opts->prng)
+			opts->input_filepath = argv[optind];
+		return 0;
+	}
+	/* Generated inputs need no input file. */
+	if (argc - optind != (opts->prng ? 2 : 3))
+		return -EINVAL;
+	opts->input_fmt = argv[optind];
+	opts->fuzz_target = argv[optind + 1];
+	if (!opts->prng)
+		opts->input_filepath = argv[optind + 2];
+	return 0;
+}
 
 int main(int argc, char *argv[])
 {
+	struct sigaction sa = { .sa_handler = handle_stop };
+	struct provenance_log *plog = NULL;
+	struct stats_collector *sc = NULL;
+	struct target_registry *reg = NULL;
+	struct watchdog *wd = NULL;
+	struct bridge_opts opts;
+	struct sink *sink;
+	size_t i;
 	int ret;
 
-	if (argc != 4) {
+	if (parse_opts(argc, argv, &opts)) {
 		printf("%s\n", usage_str);
 		return 1;
 	}
 
-	ret = invoke_one(argv[1], argv[2], argv[3]);
+	/* Sinks other than debugfs need no kernel, so do not look for one. */
+	if (opts.list_targets || opts.sink_type == SINK_DEBUGFS) {
+		reg = new_target_registry(opts.debugfs_root);
+		if (!reg) {
+			printf("failed to enumerate targets under %s\n",
+			       opts.debugfs_root ? opts.debugfs_root : KFUZZTEST_DEBUGFS_ROOT);
+			return 1;
+		}
+	}
+
+	if (opts.list_targets) {
+		for (i = 0; i < reg->num_targets; i++)
+			printf("%s\n", reg->targets[i]->name);
+		destroy_target_registry(reg);
+		return 0;
+	}
+
+	sink = new_sink(opts.sink_type, opts.output_path);
+	if (!sink) {
+		/* A harness that failed to load has already been reported. */
+		if (opts.sink_type != SINK_RECEIVER)
+			printf("failed to open output file %s\n", opts.output_path);
+		ret = 1;
+		goto out_reg;
+	}
+
+	if (opts.stats_path) {
+		sc = new_stats_collector(opts.stats_path, opts.stats_format, opts.stats_interval * NSEC_PER_SEC);
+		if (!sc) {
+			ret = 1;
+			goto out_sink;
+		}
+	}
+
+	if (opts.watchdog_ms) {
+		wd = new_watchdog(opts.watchdog_ms * 1000000, opts.hang_dir, sc);
+		if (!wd) {
+			ret = 1;
+			goto out_stats;
+		}
+	}
+
+	if (opts.provenance_path) {
+		plog = new_provenance_log(opts.provenance_path);
+		if (!plog) {
+			printf("failed to open provenance log %s\n", opts.provenance_path);
+			ret = 1;
+			goto out_watchdog;
+		}
+	}
+
+	/* No SA_RESTART, so that a blocking call returns and the stop is noticed. */
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	if (opts.serve_path) {
+		ret = run_server(opts.serve_path, reg, sink, &stop_requested);
+		if (ret)
+			printf("server failed: %s\n", strerror(-ret));
+	} else if (opts.campaign_path) {
+		ret = invoke_campaign(&opts, reg, sink, sc, wd, plog);
+	} else {
+		ret = invoke_loop(&opts, reg, sink, sc, wd, plog);
+	}
+	if (plog && destroy_provenance_log(plog) && !ret) {
+		printf("failed to write provenance log %s\n", opts.provenance_path);
+		ret = 1;
+	}
+out_watchdog:
+	if (wd)
+		destroy_watchdog(wd);
+out_stats:
+	if (sc)
+		destroy_stats_collector(sc);
+out_sink:
+	if (destroy_sink(sink) && !ret) {
+		printf("failed to flush output file %s\n", opts.output_path);
+		ret = 1;
+	}
+out_reg:
+	if (reg)
+		destroy_target_registry(reg);
 	if (ret)
 		return 1;
+	return 0;
 }
 
-static int invoke_kfuzztest_target(const char *target_name, const char *data, size_t data_size)
+static void destroy_workers(struct worker *workers, size_t num_workers)
 {
-	ssize_t bytes_written;
-	char buf[256];
-	int ret;
-	int fd;
+	size_t i;
 
-	ret = snprintf(buf, sizeof(buf), "/sys/kernel/debug/kfuzztest/%s/input", target_name);
-	if (ret < 0)
-		return ret;
+	for (i = 0; i < num_workers; i++) {
+		worker_disable_uring(&workers[i]);
+		worker_disable_pipeline(&workers[i]);
+		worker_disable_provenance(&workers[i]);
+		worker_release(&workers[i]);
+		if (workers[i].rs)
+			destroy_rand_stream(workers[i].rs);
+		/* Worker 0 borrows the registry's handle. */
+		if (i > 0 && workers[i].target)
+			destroy_target(workers[i].target);
+	}
+	free(workers);
+}
 
-	fd = openat(AT_FDCWD, buf, O_WRONLY, 0);
-	if (fd < 0)
-		return fd;
+/* Opens the input file, through a background thread if asked to. */
+static struct rand_stream *open_input_file(struct bridge_opts *opts)
+{
+	size_t size = opts->read_buffer;
 
-	bytes_written = write(fd, (void *)data, data_size);
-	if (bytes_written < 0) {
-		close(fd);
-		return bytes_written;
-	}
+	if (!size)
+		size = opts->read_ahead ? RAND_STREAM_READ_AHEAD_SIZE : RAND_STREAM_CACHE_SIZE;
+	return new_rand_stream(opts->input_filepath, size, opts->read_ahead);
+}
 
-	if (close(fd) != 0)
-		return 1;
-	return 0;
+static bool is_directory(const char *path)
+{
+	struct stat st;
+
+	return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
 }
 
-static int invoke_one(const char *input_fmt, const char *fuzz_target, const char *input_filepath)
+/* Loads the built-in interesting values, along with those of --interesting's file. */
+static int open_dictionary(struct bridge_opts *opts, struct dictionary **ret)
 {
+	int err;
+
+	err = load_dictionary(opts->dictionary_path, ret);
+	if (err && opts->dictionary_path)
+		printf("failed to load dictionary %s: %s\n", opts->dictionary_path, strerror(-err));
+	return err;
+}
+
+static int invoke_loop(struct bridge_opts *opts, struct target_registry *reg, struct sink *sink,
+		       struct stats_collector *sc, struct watchdog *wd, struct provenance_log *plog)
+{
+	struct corpus_cursor *cursors = NULL;
+	struct kfuzztest_target *target = NULL;
+	struct corpus *corpus = NULL;
+	struct shm_ring *ring = NULL;
+	uint64_t num_failed = 0;
+	uint64_t num_execs = 0;
+	struct dictionary *dict = NULL;
+	struct encode_template *tmpl;
+	struct dictionary *base;
+	struct arena *schema_arena;
 	struct ast_node *ast_prog;
-	struct byte_buffer *bb;
+	struct worker *workers;
+	uint64_t deadline = 0;
+	bool single_shot;
+	uint64_t seed = 0;
+	size_t i;
+	int err;
+
+	if (sink->type == SINK_DEBUGFS && !(target = registry_get(reg, opts->fuzz_target))) {
+		printf("invocation failed: no such target %s\n", opts->fuzz_target);
+		return -ENOENT;
+	}
+
+	schema_arena = new_arena(SCHEMA_ARENA_CHUNK_SIZE);
+	if (!schema_arena)
+		return -ENOMEM;
+	err = compile_schema(opts->input_fmt, schema_arena, &ast_prog);
+	if (!err)
+		err = compile_template(ast_prog, schema_arena, &tmpl);
+	if (err)
+		goto out;
+	if (opts->interesting) {
+		if ((err = open_dictionary(opts, &base)))
+			goto out;
+		err = dictionary_for_template(base, tmpl, &dict);
+		destroy_dictionary(base);
+		if (err)
+			goto out;
+	}
+
+	if (opts->shm_path) {
+		ring = open_shm_ring(opts->shm_path);
+		if (!ring) {
+			printf("failed to open shared-memory ring %s\n", opts->shm_path);
+			err = -EINVAL;
+			goto out;
+		}
+		/* Keep serving the producer until interrupted, unless asked otherwise. */
+		if (!opts->iterations_set)
+			opts->iterations = 0;
+	} else if (opts->prng) {
+		printf("prng seed %llu\n", (unsigned long long)opts->prng_seed);
+	} else if (is_directory(opts->input_filepath)) {
+		if (opts->mutate_inputs) {
+			printf("corpus directories cannot be mutated\n");
+			err = -EINVAL;
+			goto out;
+		}
+		/* Seeds are replayed as they are, like shared-memory and server inputs. */
+		if (opts->interesting) {
+			printf("corpus directories cannot take interesting values\n");
+			err = -EINVAL;
+			goto out;
+		}
+		seed = now_ns() ^ getpid();
+		err = load_corpus(opts->input_filepath, opts->corpus_order, seed, &corpus);
+		if (err) {
+			printf("failed to load corpus %s: %s\n", opts->input_filepath, strerror(-err));
+			goto out;
+		}
+		cursors = calloc(opts->jobs, sizeof(*cursors));
+		if (!cursors) {
+			err = -ENOMEM;
+			goto out;
+		}
+		printf("corpus: %zu seeds, seed %llu\n", corpus->num_seeds, (unsigned long long)seed);
+		/* Make a single pass over the corpus unless asked otherwise. */
+		if (!opts->iterations_set)
+			opts->iterations = corpus->num_seeds;
+	}
+
+	single_shot = opts->iterations == 1 && !corpus && !ring;
+	if (opts->duration)
+		deadline = now_ns() + opts->duration * NSEC_PER_SEC;
+
+	/* Workers are cacheline-aligned, which calloc() does not guarantee. */
+	if (posix_memalign((void **)&workers, __alignof__(struct worker), opts->jobs * sizeof(*workers))) {
+		err = -ENOMEM;
+		goto out;
+	}
+	memset(workers, 0, opts->jobs * sizeof(*workers));
+
+	for (i = 0; i < opts->jobs; i++) {
+		workers[i] = (struct worker){
+			.tmpl = tmpl,
+			.deadline = deadline,
+			.sink = sink,
+			.stop = &stop_requested,
+			.fail_fast = single_shot,
+			/* Workers take turns through the input numbers. */
+			.first_input = opts->first_input + i,
+			.input_stride = opts->jobs,
+			.mutate_inputs = opts->mutate_inputs,
+			.dict = dict,
+		};
+		/* Split a fixed iteration budget evenly, giving the remainder to the first workers. */
+		if (opts->iterations)
+			workers[i].iterations = opts->iterations / opts->jobs + (i < opts->iterations % opts->jobs);
+
+		if (ring) {
+			workers[i].ring = ring;
+		} else if (corpus) {
+			init_corpus_cursor(&cursors[i], corpus, i, opts->jobs, seed);
+			workers[i].cursor = &cursors[i];
+		} else if (opts->prng) {
+			/* Inputs are numbered independently of -j, so a run replays the same way for any -j. */
+			workers[i].rs = new_prng_rand_stream(opts->prng_seed);
+			if (!workers[i].rs) {
+				err = -ENOMEM;
+				goto out_workers;
+			}
+		} else if (!(workers[i].rs = open_input_file(opts))) {
+			printf("failed to open input file %s\n", opts->input_filepath);
+			err = -ENOENT;
+			goto out_workers;
+		}
+
+		workers[i].target = i == 0 || !target ? target : clone_target(target);
+		if (target && !workers[i].target) {
+			printf("failed to open target %s\n", target->name);
+			err = -ENOENT;
+			goto out_workers;
+		}
+
+		if (opts->uring_depth && worker_enable_uring(&workers[i], opts->uring_depth) && i == 0)
+			printf("io_uring unavailable, falling back to synchronous writes\n");
+		if (opts->pipeline_depth && (err = worker_enable_pipeline(&workers[i], opts->pipeline_depth)))
+			goto out_workers;
+
+		if (sc && !(workers[i].stats = stats_collector_add(sc, opts->fuzz_target))) {
+			err = -ENOMEM;
+			goto out_workers;
+		}
+		if (wd && !(workers[i].watch = watchdog_add(wd, opts->fuzz_target, workers[i].stats))) {
+			err = -ENOMEM;
+			goto out_workers;
+		}
+		if (plog && (err = worker_enable_provenance(&workers[i], plog, opts->fuzz_target)))
+			goto out_workers;
+	}
+
+	if (sc && (err = stats_collector_start(sc)))
+		goto out_workers;
+	if (wd && (err = watchdog_start(wd)))
+		goto out_workers;
+
+	if (opts->pipeline_depth)
+		err = run_pipeline(workers, opts->jobs);
+	else if (opts->jobs == 1)
+		err = worker_run(&workers[0]);
+	else
+		err = run_workers(workers, opts->jobs);
+
+	for (i = 0; i < opts->jobs; i++) {
+		num_execs += workers[i].num_execs;
+		num_failed += workers[i].num_failed;
+	}
+
+	if (err && single_shot)
+		printf("invocation failed: %s\n", strerror(-err));
+	if (!single_shot)
+		printf("%llu iterations, %llu failed\n", (unsigned long long)num_execs, (unsigned long long)num_failed);
+
+out_workers:
+	destroy_workers(workers, opts->jobs);
+out:
+	free(cursors);
+	if (corpus)
+		destroy_corpus(corpus);
+	if (ring)
+		close_shm_ring(ring);
+	if (dict)
+		destroy_dictionary(dict);
+	destroy_arena(schema_arena);
+	return err;
+}
+
+static int invoke_campaign(struct bridge_opts *opts, struct target_registry *reg, struct sink *sink,
+			   struct stats_collector *sc, struct watchdog *wd, struct provenance_log *plog)
+{
+	struct dictionary *base = NULL;
 	struct rand_stream *rs;
-	struct token **tokens;
-	size_t num_tokens;
-	size_t num_bytes;
+	uint64_t deadline = 0;
+	struct campaign *c;
+	size_t i;
 	int err;
 
-	err = tokenize(input_fmt, &tokens, &num_tokens);
-	if (err) {
-		printf("tokenization failed: %s\n", strerror(-err));
-		return err;
+	if (!opts->prng && is_directory(opts->input_filepath)) {
+		printf("corpus directories are not supported in campaign mode\n");
+		return -EINVAL;
 	}
 
-	err = parse(tokens, num_tokens, &ast_prog);
+	err = load_campaign(opts->campaign_path, reg, sink, &c);
 	if (err) {
-		printf("parsing failed: %s\n", strerror(-err));
+		printf("failed to load campaign %s: %s\n", opts->campaign_path, strerror(-err));
 		return err;
 	}
 
-	rs = new_rand_stream(input_filepath, 1024);
-	err = encode(ast_prog, rs, &num_bytes, &bb);
-	if (err) {
-		printf("encoding failed: %s\n", strerror(-err));
-		return err;
+	if (opts->prng) {
+		printf("prng seed %llu\n", (unsigned long long)opts->prng_seed);
+		rs = new_prng_rand_stream(opts->prng_seed);
+	} else {
+		rs = open_input_file(opts);
+	}
+	if (!rs) {
+		if (!opts->prng)
+			printf("failed to open input file %s\n", opts->input_filepath);
+		destroy_campaign(c);
+		return opts->prng ? -ENOMEM : -ENOENT;
 	}
 
-	err = invoke_kfuzztest_target(fuzz_target, bb->buffer, num_bytes);
-	if (err) {
-		printf("invocation failed: %s\n", strerror(-err));
-		return err;
+	if (opts->interesting && (err = open_dictionary(opts, &base)))
+		goto out;
+	for (i = 0; i < c->num_entries; i++) {
+		c->entries[i]->w.mutate_inputs = opts->mutate_inputs;
+		/* Every schema adds its own sizes to the dictionary. */
+		if (base && (err = dictionary_for_template(base, c->entries[i]->tmpl, &c->entries[i]->dict)))
+			goto out;
+		c->entries[i]->w.dict = c->entries[i]->dict;
+		if (opts->uring_depth && worker_enable_uring(&c->entries[i]->w, opts->uring_depth) && i == 0)
+			printf("io_uring unavailable, falling back to synchronous writes\n");
+		if (sc && !(c->entries[i]->w.stats = stats_collector_add(sc, c->entries[i]->target_name))) {
+			err = -ENOMEM;
+			goto out;
+		}
+		if (wd && !(c->entries[i]->w.watch = watchdog_add(wd, c->entries[i]->target_name, c->entries[i]->w.stats))) {
+			err = -ENOMEM;
+			goto out;
+		}
+		if (plog && (err = worker_enable_provenance(&c->entries[i]->w, plog, c->entries[i]->target_name)))
+			goto out;
+	}
+	if (sc && (err = stats_collector_start(sc)))
+		goto out;
+	if (wd && (err = watchdog_start(wd)))
+		goto out;
+
+	if (opts->duration)
+		deadline = now_ns() + opts->duration * NSEC_PER_SEC;
+
+	err = run_campaign(c, rs, opts->first_input, opts->iterations, deadline, &stop_requested);
+	print_campaign_summary(c);
+	if (err)
+		printf("campaign failed: %s\n", strerror(-err));
+
+out:
+	for (i = 0; i < c->num_entries; i++) {
+		worker_disable_uring(&c->entries[i]->w);
+		worker_disable_provenance(&c->entries[i]->w);
+		worker_release(&c->entries[i]->w);
 	}
-	destroy_byte_buffer(bb);
+	if (base)
+		destroy_dictionary(base);
+	destroy_rand_stream(rs);
+	destroy_campaign(c);
 	return err;
 }
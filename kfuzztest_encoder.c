@@ -10,178 +10,275 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include "byte_buffer.h"
-#include "kfuzztest_input_parser.h"
-#include "rand_stream.h"
+#include "byte_order.h"
+#include "kfuzztest_encoder.h"
 
 #define KFUZZTEST_MAGIC 0xBFACE
 #define KFUZZTEST_PROTO_VERSION 0
 #define KFUZZTEST_POISON_SIZE 8
 
-#define BUFSIZE_SMALL 32
-#define BUFSIZE_LARGE 128
+/* Sizes of a region array entry and of a relocation table entry. */
+#define REGION_ENTRY_SIZE (2 * sizeof(uint32_t))
+#define RELOC_ENTRY_SIZE (3 * sizeof(uint32_t))
 
-struct region_info {
-	const char *name;
-	uint32_t offset;
-	uint32_t size;
-};
-
-struct reloc_info {
-	uint32_t src_reg;
-	uint32_t offset;
-	uint32_t dst_reg;
+/**
+ * struct encoded_layout - where each part of an input goes
+ *
+ * @num_relocations: the number of pointers in the schema.
+ * @num_fields: the number of primitives and arrays in the schema.
+ * @num_lens: the number of length fields in the schema.
+ * @num_ranges: the number of ranged arrays in the schema.
+ * @header_size: the size of the magic, version, region array and relocation
+ *	table, excluding the padding that follows the table.
+ * @padding: the padding that aligns the payload, which is part of the
+ *	relocation table.
+ * @payload_size: the size of the payload, poison included, with every ranged
+ *	array at its largest.
+ */
+struct encoded_layout {
+	size_t num_relocations;
+	size_t num_fields;
+	size_t num_lens;
+	size_t num_ranges;
+	size_t header_size;
+	size_t padding;
+	size_t payload_size;
 };
 
-struct encoder_ctx {
-	struct byte_buffer *payload;
-	struct rand_stream *rand;
+/*
+ * State of a walk laying out the payload of a template's image, or of one
+ * input of a schema with ranged arrays. The header and tables are already in
+ * place, and only their per-input entries are written by the walk.
+ */
+struct template_ctx {
+	struct ast_program *prog;
 
-	struct region_info *regions;
-	size_t num_regions;
+	/* Left NULL while compiling, when fields are zeroed and ranged arrays take their largest size. */
+	struct rand_stream *r;
+	struct provenance *prov;
 
-	struct reloc_info *relocations;
+	char *base;
+	char *region_array;
+	char *reloc_table;
 	size_t num_relocations;
 
+	/* Only recorded while compiling, as inputs with ranged arrays are filled field by field. */
+	struct template_span *spans;
+	size_t num_spans;
+	struct template_field *fields;
+	size_t num_fields;
+	struct template_field *lens;
+	size_t num_lens;
+
+	char *payload;
+	size_t payload_pos;
+
 	size_t reg_offset;
 	int curr_reg;
+	int curr_member;
 };
 
-static void cleanup_ctx(struct encoder_ctx *ctx)
+static size_t round_up_to_multiple(size_t x, size_t n)
 {
-	if (ctx->regions)
-		free(ctx->regions);
-	if (ctx->relocations)
-		free(ctx->relocations);
-	if (ctx->payload)
-		destroy_byte_buffer(ctx->payload);
+	if (n == 0) {
+		return x;
+	}
+	return ((x + n - 1) / n) * n;
 }
 
-int pad_payload(struct encoder_ctx *ctx, size_t amount)
+static int compute_layout(struct ast_node *top_level, struct encoded_layout *layout)
 {
-	int ret;
+	struct ast_region *reg;
+	struct ast_node *child;
+	size_t pos = 0;
+	int i, j;
 
-	if ((ret = pad(ctx->payload, amount)))
-		return ret;
-	ctx->reg_offset += amount;
+	if (top_level->type != NODE_PROGRAM)
+		return -EINVAL;
+
+	/* Mirrors place_payload() and place_region(), without filling anything in. */
+	*layout = (struct encoded_layout){ 0 };
+	for (i = 0; i < top_level->data.program.num_members; i++) {
+		pos = round_up_to_multiple(pos, node_alignment(top_level->data.program.members[i]));
+		reg = &top_level->data.program.members[i]->data.region;
+		for (j = 0; j < reg->num_members; j++) {
+			child = reg->members[j];
+			if (child->type == NODE_POINTER)
+				layout->num_relocations++;
+			else if (child->type == NODE_LEN)
+				layout->num_lens++;
+			else if (child->type == NODE_ARRAY || child->type == NODE_PRIMITIVE)
+				layout->num_fields++;
+			else
+				return -EINVAL;
+			if (child->type == NODE_ARRAY && child->data.array.min_elems != child->data.array.num_elems)
+				layout->num_ranges++;
+			pos = round_up_to_multiple(pos, node_alignment(child)) + node_size(child);
+		}
+		pos = round_up_to_multiple(pos, node_alignment(top_level->data.program.members[i]));
+		pos += KFUZZTEST_POISON_SIZE;
+	}
+	layout->payload_size = pos;
+
+	layout->header_size = 2 * sizeof(uint32_t) + sizeof(uint32_t) +
+			      top_level->data.program.num_members * REGION_ENTRY_SIZE + 2 * sizeof(uint32_t) +
+			      layout->num_relocations * RELOC_ENTRY_SIZE;
+	layout->padding = round_up_to_multiple(layout->header_size + KFUZZTEST_POISON_SIZE, node_alignment(top_level)) -
+			  layout->header_size;
 	return 0;
 }
 
-static int round_up_to_multiple(int x, int n)
+/* Points @ctx at the tables of the input or image starting at @base. */
+static void locate_tables(struct template_ctx *ctx, char *base, size_t payload_offset)
 {
-	if (n == 0) {
-		return x;
-	}
-	return ((x + n - 1) / n) * n;
+	ctx->base = base;
+	ctx->region_array = base + 3 * sizeof(uint32_t);
+	ctx->reloc_table = ctx->region_array + ctx->prog->num_members * REGION_ENTRY_SIZE + 2 * sizeof(uint32_t);
+	ctx->payload = base + payload_offset;
 }
 
-int align_payload(struct encoder_ctx *ctx, size_t alignment)
+static void pad_payload(struct template_ctx *ctx, size_t amount)
 {
-	size_t pad_amount = round_up_to_multiple(ctx->payload->num_bytes, alignment) - ctx->payload->num_bytes;
-	return pad_payload(ctx, pad_amount);
+	memset(ctx->payload + ctx->payload_pos, 0, amount);
+	ctx->payload_pos += amount;
+	ctx->reg_offset += amount;
 }
 
-static int lookup_reg(struct encoder_ctx *ctx, const char *name)
+static void align_payload(struct template_ctx *ctx, size_t alignment)
 {
-	int i;
-
-	for (i = 0; i < ctx->num_regions; i++) {
-		if (strcmp(ctx->regions[i].name, name) == 0)
-			return i;
-	}
-	return -ENOENT;
+	pad_payload(ctx, round_up_to_multiple(ctx->payload_pos, alignment) - ctx->payload_pos);
 }
 
-static int add_reloc(struct encoder_ctx *ctx, struct reloc_info reloc)
+static void add_reloc(struct template_ctx *ctx, uint32_t src_reg, uint32_t offset, uint32_t dst_reg)
 {
-	void *new_ptr = realloc(ctx->relocations, (ctx->num_relocations + 1) * sizeof(struct reloc_info));
-	if (!new_ptr)
-		return -ENOMEM;
+	char *entry = ctx->reloc_table + ctx->num_relocations * RELOC_ENTRY_SIZE;
 
-	ctx->relocations = new_ptr;
-	ctx->relocations[ctx->num_relocations] = reloc;
+	put_le32(entry, src_reg);
+	put_le32(entry + sizeof(uint32_t), offset);
+	put_le32(entry + 2 * sizeof(uint32_t), dst_reg);
 	ctx->num_relocations++;
-	return 0;
 }
 
-static int build_region_map(struct encoder_ctx *ctx, struct ast_node *top_level)
+static int add_provenance(struct provenance *prov, const struct ast_program *prog, const struct template_field *field,
+			  uint64_t src_offset, size_t payload_offset)
 {
-	struct ast_program *prog;
-	struct ast_node *reg;
-	int i;
+	return provenance_add(prov, (struct provenance_entry){
+					    .src_offset = src_offset,
+					    .src_len = field->span.len,
+					    .region = prog->members[field->region]->data.region.name,
+					    .member = field->member,
+					    .field = field->node,
+					    .payload_offset = field->span.offset - payload_offset,
+				    });
+}
 
-	if (top_level->type != NODE_PROGRAM)
-		return -EINVAL;
+/*
+ * Records a field and fills it in: with zeroes while compiling, extending the
+ * last span if the field immediately follows it, or else from the byte source.
+ */
+static int add_field(struct template_ctx *ctx, struct ast_node *node, size_t len)
+{
+	size_t offset = ctx->payload - ctx->base + ctx->payload_pos;
+	struct template_field *field = &ctx->fields[ctx->num_fields++];
+	struct template_span *last;
+	int err;
+
+	*field = (struct template_field){
+		.span = { .offset = offset, .len = len },
+		.node = node,
+		.region = ctx->curr_reg,
+		.member = ctx->curr_member,
+	};
+
+	if (ctx->r) {
+		if (ctx->prov &&
+		    (err = add_provenance(ctx->prov, ctx->prog, field, ctx->r->offset, ctx->payload - ctx->base)))
+			return err;
+		return next_bytes(ctx->r, ctx->base + offset, len);
+	}
 
-	prog = &top_level->data.program;
-	ctx->regions = malloc(prog->num_members * sizeof(struct region_info));
-	if (!ctx->regions)
-		return -ENOMEM;
+	/* Filled with fresh bytes for every input; zeroed only to keep the image defined. */
+	memset(ctx->base + offset, 0, len);
+	last = ctx->num_spans ? &ctx->spans[ctx->num_spans - 1] : NULL;
+	if (last && last->offset + last->len == offset)
+		last->len += len;
+	else
+		ctx->spans[ctx->num_spans++] = (struct template_span){ .offset = offset, .len = len };
+	return 0;
+}
 
-	ctx->num_regions = prog->num_members;
-	for (i = 0; i < ctx->num_regions; i++) {
-		reg = prog->members[i];
-		/* Offset can only be determined after the second pass. */
-		ctx->regions[i] = (struct region_info){
-			.name = reg->data.region.name,
-			.size = node_size(reg),
-		};
-	}
+/* Records a length field, which is filled in by fill_lens() once every region has been placed. */
+static void add_len(struct template_ctx *ctx, struct ast_node *node)
+{
+	size_t offset = ctx->payload - ctx->base + ctx->payload_pos;
+
+	ctx->lens[ctx->num_lens++] = (struct template_field){
+		.span = { .offset = offset, .len = node->data.len.byte_width },
+		.node = node,
+		.region = ctx->curr_reg,
+		.member = ctx->curr_member,
+	};
+}
+
+/* Picks the number of elements of a ranged array from the next bytes of the byte source. */
+static int draw_num_elems(struct rand_stream *r, const struct ast_array *arr, size_t *ret)
+{
+	char bits[sizeof(uint32_t)];
+	int err;
+
+	if ((err = next_bytes(r, bits, sizeof(bits))))
+		return err;
+	*ret = arr->min_elems + get_le32(bits) % (arr->num_elems - arr->min_elems + 1);
 	return 0;
 }
+
 /**
- * Encodes a value node as little-endian. A value node is one that can be
- * directly written, i.e. a primitive, a pointer, or an array.
+ * Places a value node in the payload. A value node is one that can be
+ * directly written, i.e. a primitive, a pointer, a length or an array.
  */
-static int encode_value_le(struct encoder_ctx *ctx, struct ast_node *node)
+static int place_value(struct template_ctx *ctx, struct ast_node *node)
 {
-	size_t array_size;
-	char rand_char;
-	int dst_reg;
-	int ret;
-	int i;
+	char *dst = ctx->payload + ctx->payload_pos;
+	size_t num_elems;
+	size_t value_size;
+	int err;
 
 	switch (node->type) {
 	case NODE_ARRAY:
-		array_size = node->data.array.num_elems * node->data.array.elem_size;
-		for (i = 0; i < array_size; i++) {
-			if ((ret = next_byte(ctx->rand, &rand_char)))
-				return ret;
-			if ((ret = append_byte(ctx->payload, rand_char)))
-				return ret;
-		}
-		ctx->reg_offset += array_size;
+		num_elems = node->data.array.num_elems;
+		if (ctx->r && node->data.array.min_elems != num_elems &&
+		    (err = draw_num_elems(ctx->r, &node->data.array, &num_elems)))
+			return err;
+		value_size = num_elems * node->data.array.elem_size;
+		if ((err = add_field(ctx, node, value_size)))
+			return err;
 		break;
 	case NODE_PRIMITIVE:
-		for (i = 0; i < node->data.primitive.byte_width; i++) {
-			if ((ret = next_byte(ctx->rand, &rand_char)))
-				return ret;
-			if ((ret = append_byte(ctx->payload, rand_char)))
-				return ret;
-		}
-		ctx->reg_offset += node->data.primitive.byte_width;
+		value_size = node->data.primitive.byte_width;
+		if ((err = add_field(ctx, node, value_size)))
+			return err;
 		break;
 	case NODE_POINTER:
-		dst_reg = lookup_reg(ctx, node->data.pointer.points_to);
-		if (dst_reg < 0)
-			return dst_reg;
-		if ((ret = add_reloc(ctx, (struct reloc_info){ .src_reg = ctx->curr_reg,
-							       .offset = ctx->reg_offset,
-							       .dst_reg = dst_reg })))
-			return ret;
+		add_reloc(ctx, ctx->curr_reg, ctx->reg_offset, node->data.pointer.region);
 		/* Placeholder pointer value, as pointers are patched by KFuzzTest anyways. */
-		encode_le(ctx->payload, UINTPTR_MAX, sizeof(uintptr_t));
-		ctx->reg_offset += sizeof(uintptr_t);
+		value_size = sizeof(uintptr_t);
+		memset(dst, 0xFF, value_size);
+		break;
+	case NODE_LEN:
+		add_len(ctx, node);
+		value_size = node->data.len.byte_width;
 		break;
 	case NODE_PROGRAM:
 	case NODE_REGION:
 	default:
 		return -1;
 	}
+	ctx->payload_pos += value_size;
+	ctx->reg_offset += value_size;
 	return 0;
 }
 
-static int encode_region(struct encoder_ctx *ctx, struct ast_region *reg)
+static int place_region(struct template_ctx *ctx, struct ast_region *reg)
 {
 	struct ast_node *child;
 	int ret;
@@ -191,147 +288,187 @@ static int encode_region(struct encoder_ctx *ctx, struct ast_region *reg)
 	for (i = 0; i < reg->num_members; i++) {
 		child = reg->members[i];
 		align_payload(ctx, node_alignment(child));
-		if ((ret = encode_value_le(ctx, child)))
+		ctx->curr_member = i;
+		if ((ret = place_value(ctx, child)))
 			return ret;
 	}
 	return 0;
 }
 
-static int encode_payload(struct encoder_ctx *ctx, struct ast_node *top_level)
+static int place_payload(struct template_ctx *ctx)
 {
 	struct ast_node *reg;
+	char *entry;
 	int ret;
 	int i;
 
-	for (i = 0; i < ctx->num_regions; i++) {
-		reg = top_level->data.program.members[i];
+	for (i = 0; i < ctx->prog->num_members; i++) {
+		reg = ctx->prog->members[i];
 		align_payload(ctx, node_alignment(reg));
 
 		ctx->curr_reg = i;
-		ctx->regions[i].offset = ctx->payload->num_bytes;
-		if ((ret = encode_region(ctx, &reg->data.region)))
+		entry = ctx->region_array + i * REGION_ENTRY_SIZE;
+		put_le32(entry, ctx->payload_pos);
+		if ((ret = place_region(ctx, &reg->data.region)))
 			return ret;
+		/* Like a C struct, a region includes the padding that aligns its end. */
+		align_payload(ctx, node_alignment(reg));
+		put_le32(entry + sizeof(uint32_t), ctx->reg_offset);
 		pad_payload(ctx, KFUZZTEST_POISON_SIZE);
 	}
 	return 0;
 }
 
-static struct byte_buffer *encode_region_array(struct encoder_ctx *ctx)
+/* Writes every length field, reading the size of its region back from the region array. */
+static void fill_lens(struct template_ctx *ctx)
 {
-	struct byte_buffer *reg_array;
-	struct region_info info;
-	int i;
-
-	reg_array = new_byte_buffer(BUFSIZE_SMALL);
-	if (!reg_array)
-		return NULL;
-
-	if (encode_le(reg_array, ctx->num_regions, sizeof(uint32_t)))
-		goto fail;
-
-	for (i = 0; i < ctx->num_regions; i++) {
-		info = ctx->regions[i];
-		if (encode_le(reg_array, info.offset, sizeof(uint32_t)))
-			goto fail;
-		if (encode_le(reg_array, info.size, sizeof(uint32_t)))
-			goto fail;
+	const struct template_field *len;
+	const struct ast_len *node;
+	size_t size;
+	size_t i;
+
+	for (i = 0; i < ctx->num_lens; i++) {
+		len = &ctx->lens[i];
+		node = &len->node->data.len;
+		size = get_le32(ctx->region_array + node->region * REGION_ENTRY_SIZE + sizeof(uint32_t));
+		store_le(ctx->base + len->span.offset, len->span.len, size / node->unit);
 	}
-	return reg_array;
-
-fail:
-	destroy_byte_buffer(reg_array);
-	return NULL;
 }
 
-static struct byte_buffer *encode_reloc_table(struct encoder_ctx *ctx, size_t padding_amount)
+int compile_template(struct ast_node *top_level, struct arena *arena, struct encode_template **ret)
 {
-	struct byte_buffer *reloc_table;
-	struct reloc_info info;
-	int i;
+	struct encoded_layout layout;
+	struct encode_template *t;
+	struct template_ctx ctx;
+	int err;
 
-	reloc_table = new_byte_buffer(BUFSIZE_SMALL);
-	if (!reloc_table)
-		return NULL;
-
-	if (encode_le(reloc_table, ctx->num_relocations, sizeof(uint32_t)))
-		goto fail;
-	if (encode_le(reloc_table, padding_amount, sizeof(uint32_t)))
-		goto fail;
-
-	for (i = 0; i < ctx->num_relocations; i++) {
-		info = ctx->relocations[i];
-		if (encode_le(reloc_table, info.src_reg, sizeof(uint32_t)))
-			goto fail;
-		if (encode_le(reloc_table, info.offset, sizeof(uint32_t)))
-			goto fail;
-		if (encode_le(reloc_table, info.dst_reg, sizeof(uint32_t)))
-			goto fail;
-	}
-	pad(reloc_table, padding_amount);
-	return reloc_table;
+	if ((err = compute_layout(top_level, &layout)))
+		return err;
+
+	/* Everything below is allocated from @arena, so failures need no cleanup. */
+	t = arena_alloc(arena, sizeof(*t));
+	if (!t)
+		return -ENOMEM;
+	*t = (struct encode_template){
+		.size = layout.header_size + layout.padding + layout.payload_size,
+		.payload_offset = layout.header_size + layout.padding,
+		.num_fields = layout.num_fields,
+		.num_lens = layout.num_lens,
+		.num_ranges = layout.num_ranges,
+		.prog = &top_level->data.program,
+	};
+	t->image = arena_alloc(arena, t->size);
+	/* Spans merge adjacent fields, so there are at most as many. */
+	t->spans = arena_alloc(arena, layout.num_fields * sizeof(struct template_span));
+	t->fields = arena_alloc(arena, (layout.num_fields + layout.num_lens) * sizeof(struct template_field));
+	if (!t->image || !t->spans || !t->fields)
+		return -ENOMEM;
 
-fail:
-	destroy_byte_buffer(reloc_table);
-	return NULL;
+	ctx = (struct template_ctx){
+		.prog = t->prog,
+		.spans = t->spans,
+		.fields = t->fields,
+		.lens = t->fields + t->num_fields,
+	};
+	locate_tables(&ctx, t->image, t->payload_offset);
+
+	/* The header, then the tables, whose entries are filled in along with the payload. */
+	put_le32(t->image, KFUZZTEST_MAGIC);
+	put_le32(t->image + sizeof(uint32_t), KFUZZTEST_PROTO_VERSION);
+	put_le32(t->image + 2 * sizeof(uint32_t), ctx.prog->num_members);
+	put_le32(ctx.reloc_table - 2 * sizeof(uint32_t), layout.num_relocations);
+	put_le32(ctx.reloc_table - sizeof(uint32_t), layout.padding);
+	memset(ctx.reloc_table + layout.num_relocations * RELOC_ENTRY_SIZE, 0, layout.padding);
+
+	if ((err = place_payload(&ctx)))
+		return err;
+	/* Without ranged arrays, every input has the same lengths, so they are part of the image. */
+	fill_lens(&ctx);
+	t->num_spans = ctx.num_spans;
+
+	*ret = t;
+	return 0;
 }
 
-static size_t reloc_table_size(struct encoder_ctx *ctx)
+/*
+ * Encodes an input of a schema with ranged arrays, whose layout is worked out
+ * anew: the header is copied from the image, and the payload is laid out
+ * like the image was, drawing the length of each ranged array from @r right
+ * before its elements.
+ */
+static int encode_ranged(const struct encode_template *t, struct rand_stream *r, struct provenance *prov, char *buf,
+			 struct template_field *fields, size_t *num_bytes)
 {
-	return 2 * sizeof(uint32_t) + 3 * ctx->num_relocations * sizeof(uint32_t);
+	struct template_ctx ctx = {
+		.prog = t->prog,
+		.r = r,
+		.prov = prov,
+		.fields = fields,
+		.lens = fields + t->num_fields,
+	};
+	int err;
+
+	memcpy(buf, t->image, t->payload_offset);
+	locate_tables(&ctx, buf, t->payload_offset);
+	if ((err = place_payload(&ctx)))
+		return err;
+	fill_lens(&ctx);
+
+	*num_bytes = t->payload_offset + ctx.payload_pos;
+	return 0;
 }
 
-int encode(struct ast_node *top_level, struct rand_stream *r, size_t *num_bytes, struct byte_buffer **ret)
+int encode_into(const struct encode_template *t, struct rand_stream *r, struct provenance *prov, char *buf,
+		size_t size, struct template_field *fields, size_t *num_bytes)
 {
-	struct byte_buffer *region_array = NULL;
-	struct byte_buffer *final_buffer = NULL;
-	struct byte_buffer *reloc_table = NULL;
-	size_t header_size;
-	int alignment;
-	int retcode;
-
-	struct encoder_ctx ctx = { 0 };
-	if (build_region_map(&ctx, top_level))
-		goto fail_early;
-
-	ctx.rand = r;
-	ctx.payload = new_byte_buffer(32);
-	if (!ctx.payload)
-		goto fail_early;
-	if (encode_payload(&ctx, top_level))
-		goto fail_early;
-
-	region_array = encode_region_array(&ctx);
-	if (!region_array)
-		goto fail_early;
-
-	header_size = sizeof(uint64_t) + region_array->num_bytes + reloc_table_size(&ctx);
-	alignment = node_alignment(top_level);
-	reloc_table = encode_reloc_table(&ctx, round_up_to_multiple(header_size + KFUZZTEST_POISON_SIZE, alignment) -
-						       header_size);
-	if (!reloc_table)
-		goto fail_early;
-
-	final_buffer = new_byte_buffer(BUFSIZE_LARGE);
-	if (!final_buffer)
-		goto fail_early;
-
-	if ((retcode = encode_le(final_buffer, KFUZZTEST_MAGIC, sizeof(uint32_t))) ||
-	    (retcode = encode_le(final_buffer, KFUZZTEST_PROTO_VERSION, sizeof(uint32_t))) ||
-	    (retcode = append_bytes(final_buffer, region_array->buffer, region_array->num_bytes)) ||
-	    (retcode = append_bytes(final_buffer, reloc_table->buffer, reloc_table->num_bytes)) ||
-	    (retcode = append_bytes(final_buffer, ctx.payload->buffer, ctx.payload->num_bytes))) {
-		destroy_byte_buffer(final_buffer);
-		goto fail_early;
+	const struct template_span *span;
+	size_t num_spans;
+	size_t pos = 0;
+	size_t i;
+	int ret;
+
+	if (size < t->size)
+		return -ENOSPC;
+
+	if (prov) {
+		prov->num_entries = 0;
+		prov->payload_offset = t->payload_offset;
+	}
+	if (t->num_ranges)
+		return fields ? encode_ranged(t, r, prov, buf, fields, num_bytes) : -EINVAL;
+
+	/* Provenance is tracked field by field; otherwise adjacent fields are filled in one go. */
+	num_spans = prov ? t->num_fields : t->num_spans;
+	for (i = 0; i < num_spans; i++) {
+		span = prov ? &t->fields[i].span : &t->spans[i];
+		if (prov && (ret = add_provenance(prov, t->prog, &t->fields[i], r->offset, t->payload_offset)))
+			return ret;
+		/* Every byte is written once: from the template up to the span, then from @r. */
+		memcpy(buf + pos, t->image + pos, span->offset - pos);
+		if ((ret = next_bytes(r, buf + span->offset, span->len)))
+			return ret;
+		pos = span->offset + span->len;
 	}
+	memcpy(buf + pos, t->image + pos, t->size - pos);
 
-	*num_bytes = final_buffer->num_bytes;
-	*ret = final_buffer;
+	*num_bytes = t->size;
+	return 0;
+}
 
-fail_early:
-	if (region_array)
-		destroy_byte_buffer(region_array);
-	if (reloc_table)
-		destroy_byte_buffer(reloc_table);
-	cleanup_ctx(&ctx);
-	return retcode;
+int encode(const struct encode_template *t, struct rand_stream *r, struct provenance *prov, struct arena *arena,
+	   struct template_field *fields, size_t *num_bytes, char **ret)
+{
+	char *buf;
+	int err;
+
+	buf = arena_alloc(arena, t->size);
+	if (!buf)
+		return -ENOMEM;
+	if (t->num_ranges && !fields &&
+	    !(fields = arena_alloc(arena, (t->num_fields + t->num_lens) * sizeof(struct template_field))))
+		return -ENOMEM;
+	if ((err = encode_into(t, r, prov, buf, t->size, fields, num_bytes)))
+		return err;
+	*ret = buf;
+	return 0;
 }
@@ -1,9 +1,127 @@
 #ifndef KFUZZTEST_ENCODER_H
 #define KFUZZTEST_ENCODER_H
 
+#include "arena.h"
 #include "kfuzztest_input_parser.h"
+#include "provenance.h"
 #include "rand_stream.h"
 
-int encode(struct ast_node *top_level, struct rand_stream *r, size_t *num_bytes, struct byte_buffer **ret);
+/* Chunk size of the arenas that inputs are encoded into. */
+#define ENCODE_ARENA_CHUNK_SIZE (64 * 1024)
+
+/* A run of bytes in an input that is filled from the byte source. */
+struct template_span {
+	size_t offset;
+	size_t len;
+};
+
+/**
+ * struct template_field - a primitive, array or length field of the schema
+ *
+ * @span: where the field's bytes go in the input.
+ * @node: the field in the schema.
+ * @region: the index of the region holding the field.
+ * @member: the index of the field in its region.
+ */
+struct template_field {
+	struct template_span span;
+	struct ast_node *node;
+	size_t region;
+	size_t member;
+};
+
+/**
+ * struct encode_template - a schema laid out as a KFuzzTest input
+ *
+ * @image: an input with every field left zero. Its header, region array,
+ *	relocation table, alignment padding, poison, pointer placeholders and
+ *	length fields are identical in every input encoded from the schema.
+ * @size: the size of @image, and of every input.
+ * @payload_offset: the offset of the payload in @image.
+ * @spans: the runs of bytes filled from the byte source, in order. Adjacent
+ *	fields share a span.
+ * @num_spans: the number of @spans.
+ * @fields: every primitive and array of the schema, in order, followed by its
+ *	length fields.
+ * @num_fields: the number of primitives and arrays in @fields.
+ * @num_lens: the number of length fields in @fields.
+ * @num_ranges: the number of ranged arrays of the schema.
+ * @prog: the schema.
+ *
+ * Encoding an input only copies @image and fills in @spans, so the layout of
+ * the schema is worked out once, when the template is compiled.
+ *
+ * That is, unless the schema has ranged arrays, whose lengths change the
+ * layout of every input. @image and @fields then have every ranged array at
+ * its largest, so @size bounds the size of every input, and each input is
+ * laid out as it is encoded.
+ */
+struct encode_template {
+	char *image;
+	size_t size;
+	size_t payload_offset;
+	struct template_span *spans;
+	size_t num_spans;
+	struct template_field *fields;
+	size_t num_fields;
+	size_t num_lens;
+	size_t num_ranges;
+	struct ast_program *prog;
+};
+
+/**
+ * compile_template - lay out a schema
+ *
+ * @top_level: the compiled schema, which must outlive the template.
+ * @arena: the arena that the template is allocated from.
+ * @ret: return pointer for the template.
+ *
+ * @return 0 on success or a negative errno on failure.
+ */
+int compile_template(struct ast_node *top_level, struct arena *arena, struct encode_template **ret);
+
+/**
+ * encode_into - encode one input into a caller-supplied buffer
+ *
+ * @t: the schema's template.
+ * @r: the byte source that fields are filled from.
+ * @prov: if set, filled in with the source of every field.
+ * @buf: the buffer that the input is written to.
+ * @size: the size of @buf, at least @t->size.
+ * @fields: room for @t->num_fields + @t->num_lens fields, filled in with
+ *	where the fields of the input went if @t has ranged arrays. Inputs of
+ *	other schemas are laid out like @t->fields, and leave it untouched.
+ * @num_bytes: return pointer for the size of the input.
+ *
+ * Every byte of the input is written exactly once, so encoding allocates
+ * nothing and copies nothing twice. Inputs with ranged arrays are the
+ * exception: the few bytes of their tables and length fields that depend on
+ * the layout are written twice.
+ *
+ * @return 0 on success, -ENOSPC if @buf is too small, -EINVAL if @t has ranged
+ * arrays and @fields is NULL, or another negative errno on failure.
+ */
+int encode_into(const struct encode_template *t, struct rand_stream *r, struct provenance *prov, char *buf,
+		size_t size, struct template_field *fields, size_t *num_bytes);
+
+/**
+ * encode - encode one input in the KFuzzTest binary format
+ *
+ * @t: the schema's template.
+ * @r: the byte source that fields are filled from.
+ * @prov: if set, filled in with the source of every field.
+ * @arena: the arena that the input is allocated from, in a single allocation
+ *	of @t->size bytes, which is its exact size unless @t has ranged arrays.
+ *	The caller resets it once done with the input, so that encoding does not
+ *	call malloc() in steady state.
+ * @fields: as for encode_into(), or NULL to take room for them from @arena if
+ *	@t has ranged arrays.
+ * @num_bytes: return pointer for the size of the input.
+ * @ret: return pointer for the input, valid until @arena is reset.
+ *
+ * @return 0 on success or a negative errno on failure.
+ */
+int encode(const struct encode_template *t, struct rand_stream *r, struct provenance *prov, struct arena *arena,
+	   struct template_field *fields, size_t *num_bytes, char **ret);
 
 #endif /* KFUZZTEST_ENCODER_H */
@@ -19,22 +19,26 @@ struct keyword_map {
 };
 
 static struct keyword_map keywords[] = {
-	{ "ptr", TOKEN_KEYWORD_PTR }, { "arr", TOKEN_KEYWORD_ARR }, { "u8", TOKEN_KEYWORD_U8 },
-	{ "u16", TOKEN_KEYWORD_U16 }, { "u32", TOKEN_KEYWORD_U32 }, { "u64", TOKEN_KEYWORD_U64 },
+	{ "ptr", TOKEN_KEYWORD_PTR }, { "arr", TOKEN_KEYWORD_ARR }, { "len", TOKEN_KEYWORD_LEN },
+	{ "u8", TOKEN_KEYWORD_U8 },   { "u16", TOKEN_KEYWORD_U16 }, { "u32", TOKEN_KEYWORD_U32 },
+	{ "u64", TOKEN_KEYWORD_U64 },
 };
 
-static struct token *make_token(enum token_type type)
-{
-	struct token *ret = calloc(1, sizeof(*ret));
-	ret->type = type;
-	return ret;
-}
-
 struct lexer {
 	const char *start;
 	const char *current;
+	struct arena *arena;
 };
 
+static struct token *make_token(struct lexer *l, enum token_type type)
+{
+	struct token *ret = arena_alloc(l->arena, sizeof(*ret));
+
+	if (ret)
+		*ret = (struct token){ .type = type };
+	return ret;
+}
+
 static char advance(struct lexer *l)
 {
 	l->current++;
@@ -92,8 +96,9 @@ static struct token *number(struct lexer *l)
 	while (is_digit(peek(l)))
 		advance(l);
 	value = strtoull(l->start, NULL, 10);
-	tok = make_token(TOKEN_INTEGER);
-	tok->data.integer = value;
+	tok = make_token(l, TOKEN_INTEGER);
+	if (tok)
+		tok->data.integer = value;
 	return tok;
 }
 
@@ -120,8 +125,8 @@ static struct token *identifier(struct lexer *l)
 		}
 	}
 
-	tok = make_token(type);
-	if (type == TOKEN_IDENTIFIER) {
+	tok = make_token(l, type);
+	if (tok && type == TOKEN_IDENTIFIER) {
 		tok->data.identifier.start = l->start;
 		tok->data.identifier.length = l->current - l->start;
 	}
@@ -137,29 +142,34 @@ static struct token *scan_token(struct lexer *l)
 	c = peek(l);
 
 	if (c == '\0')
-		return make_token(TOKEN_EOF);
+		return make_token(l, TOKEN_EOF);
 
 	advance(l);
 	switch (c) {
 	case '{':
-		return make_token(TOKEN_LBRACE);
+		return make_token(l, TOKEN_LBRACE);
 	case '}':
-		return make_token(TOKEN_RBRACE);
+		return make_token(l, TOKEN_RBRACE);
 	case '[':
-		return make_token(TOKEN_LBRACKET);
+		return make_token(l, TOKEN_LBRACKET);
 	case ']':
-		return make_token(TOKEN_RBRACKET);
+		return make_token(l, TOKEN_RBRACKET);
 	case ',':
-		return make_token(TOKEN_COMMA);
+		return make_token(l, TOKEN_COMMA);
 	case ';':
-		return make_token(TOKEN_SEMICOLON);
+		return make_token(l, TOKEN_SEMICOLON);
+	case '.':
+		if (peek(l) != '.')
+			return make_token(l, TOKEN_ERROR);
+		advance(l);
+		return make_token(l, TOKEN_DOTDOT);
 	default:
 		retreat(l);
 		if (is_digit(c))
 			return number(l);
 		if (is_alpha(c) || c == '_')
 			return identifier(l);
-		return make_token(TOKEN_ERROR);
+		return make_token(l, TOKEN_ERROR);
 	}
 }
 
@@ -179,57 +189,44 @@ int primitive_byte_width(enum token_type type)
 	}
 }
 
-int tokenize(const char *input, struct token ***tokens, size_t *num_tokens)
+int tokenize(const char *input, struct arena *arena, struct token ***tokens, size_t *num_tokens)
 {
-	struct lexer l = { .start = input, .current = input };
+	struct lexer l = { .start = input, .current = input, .arena = arena };
 	struct token **ret_tokens;
 	size_t token_arr_size;
 	size_t token_count;
 	struct token *tok;
 	void *tmp;
-	size_t i;
-	int err;
 
 	token_arr_size = 128;
-	ret_tokens = calloc(token_arr_size, sizeof(struct token *));
+	ret_tokens = arena_alloc(arena, token_arr_size * sizeof(struct token *));
 	if (!ret_tokens)
 		return -ENOMEM;
 
 	token_count = 0;
 	do {
 		tok = scan_token(&l);
-		if (!tok) {
-			err = -ENOMEM;
-			goto failure;
-		}
+		if (!tok)
+			return -ENOMEM;
 
 		if (token_count == token_arr_size) {
-			token_arr_size *= 2;
-			tmp = realloc(ret_tokens, token_arr_size);
-			if (!tmp) {
-				err = -ENOMEM;
-				goto failure;
-			}
+			tmp = arena_grow(arena, ret_tokens, token_arr_size * sizeof(struct token *),
+					 2 * token_arr_size * sizeof(struct token *));
+			if (!tmp)
+				return -ENOMEM;
 			ret_tokens = tmp;
+			token_arr_size *= 2;
 		}
 
 		ret_tokens[token_count] = tok;
-		if (tok->type == TOKEN_ERROR) {
-			err = -EINVAL;
-			goto failure;
-		}
+		if (tok->type == TOKEN_ERROR)
+			return -EINVAL;
 		token_count++;
 	} while (tok->type != TOKEN_EOF);
 
 	*tokens = ret_tokens;
 	*num_tokens = token_count;
 	return 0;
-
-failure:
-	for (i = 0; i < token_count; i++)
-		free(ret_tokens[i]);
-	free(ret_tokens);
-	return err;
 }
 
 bool is_primitive(struct token *tok)
@@ -11,6 +11,8 @@
 #include <stdlib.h>
 #include <stdbool.h>
 
+#include "arena.h"
+
 #define COUNT_OF(_Array) (sizeof(_Array) / sizeof(_Array[0]))
 
 enum token_type {
@@ -20,9 +22,11 @@ enum token_type {
 	TOKEN_RBRACKET,
 	TOKEN_COMMA,
 	TOKEN_SEMICOLON,
+	TOKEN_DOTDOT,
 
 	TOKEN_KEYWORD_PTR,
 	TOKEN_KEYWORD_ARR,
+	TOKEN_KEYWORD_LEN,
 	TOKEN_KEYWORD_U8,
 	TOKEN_KEYWORD_U16,
 	TOKEN_KEYWORD_U32,
@@ -36,10 +40,11 @@ enum token_type {
 };
 
 static const char *token_names[] = {
-	"TOKEN_LBRACE",	    "TOKEN_RBRACE",	 "TOKEN_LBRACKET",    "TOKEN_RBRACKET",
-	"TOKEN_COMMA",	    "TOKEN_SEMICOLON",	 "TOKEN_KEYWORD_PTR", "TOKEN_KEYWORD_ARR",
-	"TOKEN_KEYWORD_U8", "TOKEN_KEYWORD_U16", "TOKEN_KEYWORD_U32", "TOKEN_KEYWORD_U64",
-	"TOKEN_IDENTIFIER", "TOKEN_INTEGER",	 "TOKEN_EOF",	      "TOKEN_ERROR",
+	"TOKEN_LBRACE",	     "TOKEN_RBRACE",	   "TOKEN_LBRACKET",	"TOKEN_RBRACKET",
+	"TOKEN_COMMA",	     "TOKEN_SEMICOLON",	   "TOKEN_DOTDOT",	"TOKEN_KEYWORD_PTR",
+	"TOKEN_KEYWORD_ARR", "TOKEN_KEYWORD_LEN",  "TOKEN_KEYWORD_U8",	"TOKEN_KEYWORD_U16",
+	"TOKEN_KEYWORD_U32", "TOKEN_KEYWORD_U64",  "TOKEN_IDENTIFIER",	"TOKEN_INTEGER",
+	"TOKEN_EOF",	     "TOKEN_ERROR",
 };
 
 struct token {
@@ -54,7 +59,17 @@ struct token {
 	int position;
 };
 
-int tokenize(const char *input, struct token ***tokens, size_t *num_tokens);
+/**
+ * tokenize - split a textual input description into tokens
+ *
+ * @input: the textual description.
+ * @arena: the arena that the tokens and the token array are allocated from.
+ * @tokens: return pointer for the array of tokens, ending with TOKEN_EOF.
+ * @num_tokens: return pointer for the number of tokens.
+ *
+ * @return 0 on success or a negative errno on failure.
+ */
+int tokenize(const char *input, struct arena *arena, struct token ***tokens, size_t *num_tokens);
 
 bool is_primitive(struct token *tok);
 int primitive_byte_width(enum token_type type);
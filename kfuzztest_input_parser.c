@@ -7,12 +7,18 @@
 #include <asm-generic/errno-base.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/types.h>
 
 #include "kfuzztest_input_lexer.h"
 #include "kfuzztest_input_parser.h"
 
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
 
+static size_t round_up(size_t x, size_t n)
+{
+	return (x + n - 1) / n * n;
+}
+
 static struct token *peek(struct parser *p)
 {
 	return p->tokens[p->curr_token];
@@ -40,6 +46,36 @@ static bool match(struct parser *p, enum token_type t)
 	return tok->type == t;
 }
 
+static struct ast_node *new_node(struct parser *p, enum ast_node_type type)
+{
+	struct ast_node *ret = arena_alloc(p->arena, sizeof(*ret));
+
+	if (ret)
+		ret->type = type;
+	return ret;
+}
+
+/*
+ * Appends @node to an array of @*num_members nodes, whose capacity doubles
+ * whenever it is a power of two.
+ */
+static int append_node(struct parser *p, struct ast_node ***members, size_t *num_members, struct ast_node *node)
+{
+	size_t n = *num_members;
+	void *new_ptr;
+
+	if ((n & (n - 1)) == 0) {
+		new_ptr = arena_grow(p->arena, *members, n * sizeof(struct ast_node *),
+				     (n ? 2 * n : 1) * sizeof(struct ast_node *));
+		if (!new_ptr)
+			return -ENOMEM;
+		*members = new_ptr;
+	}
+	(*members)[n] = node;
+	*num_members = n + 1;
+	return 0;
+}
+
 static int parse_primitive(struct parser *p, struct ast_node **node_ret)
 {
 	struct ast_node *ret;
@@ -51,11 +87,10 @@ static int parse_primitive(struct parser *p, struct ast_node **node_ret)
 	if (!byte_width)
 		return -EINVAL;
 
-	ret = malloc(sizeof(*ret));
+	ret = new_node(p, NODE_PRIMITIVE);
 	if (!ret)
 		return -ENOMEM;
 
-	ret->type = NODE_PRIMITIVE;
 	ret->data.primitive.byte_width = byte_width;
 	*node_ret = ret;
 	return 0;
@@ -78,14 +113,10 @@ static int parse_ptr(struct parser *p, struct ast_node **node_ret)
 	if (!consume(p, TOKEN_RBRACKET, "expected ']'"))
 		return -EINVAL;
 
-	ret = malloc(sizeof(*ret));
-	ret->type = NODE_POINTER;
-
-	points_to = strndup(tok->data.identifier.start, tok->data.identifier.length);
-	if (!points_to) {
-		free(ret);
-		return -EINVAL;
-	}
+	ret = new_node(p, NODE_POINTER);
+	points_to = arena_strndup(p->arena, tok->data.identifier.start, tok->data.identifier.length);
+	if (!ret || !points_to)
+		return -ENOMEM;
 
 	ret->data.pointer.points_to = points_to;
 	*node_ret = ret;
@@ -94,7 +125,7 @@ static int parse_ptr(struct parser *p, struct ast_node **node_ret)
 
 static int parse_arr(struct parser *p, struct ast_node **node_ret)
 {
-	struct token *type, *num_elems;
+	struct token *type, *num_elems, *max_elems = NULL;
 	struct ast_node *ret;
 
 	if (!consume(p, TOKEN_KEYWORD_ARR, "expected 'arr'") || !consume(p, TOKEN_LBRACKET, "expected '['"))
@@ -111,20 +142,68 @@ static int parse_arr(struct parser *p, struct ast_node **node_ret)
 	if (num_elems->type != TOKEN_INTEGER)
 		return -EINVAL;
 
+	if (match(p, TOKEN_DOTDOT)) {
+		advance(p);
+		max_elems = consume(p, TOKEN_INTEGER, "expected integer");
+		if (!max_elems)
+			return -EINVAL;
+		if (max_elems->data.integer < num_elems->data.integer) {
+			printf("parser failure: empty range %llu..%llu\n", (unsigned long long)num_elems->data.integer,
+			       (unsigned long long)max_elems->data.integer);
+			return -EINVAL;
+		}
+	}
+
 	if (!consume(p, TOKEN_RBRACKET, "expected ']'"))
 		return -EINVAL;
 
-	ret = malloc(sizeof(*ret));
+	ret = new_node(p, NODE_ARRAY);
 	if (!ret)
 		return -ENOMEM;
 
-	ret->type = NODE_ARRAY;
-	ret->data.array.num_elems = num_elems->data.integer;
+	ret->data.array.min_elems = num_elems->data.integer;
+	ret->data.array.num_elems = max_elems ? max_elems->data.integer : num_elems->data.integer;
 	ret->data.array.elem_size = primitive_byte_width(type->type);
 	*node_ret = ret;
 	return 0;
 }
 
+/* len[<region>] is a u64, unless a width is given, as in len[<region>, u32]. */
+static int parse_len(struct parser *p, struct ast_node **node_ret)
+{
+	const char *target;
+	struct ast_node *ret;
+	struct token *tok;
+	int byte_width = sizeof(uint64_t);
+
+	if (!consume(p, TOKEN_KEYWORD_LEN, "expected 'len'") || !consume(p, TOKEN_LBRACKET, "expected '['"))
+		return -EINVAL;
+
+	tok = consume(p, TOKEN_IDENTIFIER, "expected identifier");
+	if (!tok)
+		return -EINVAL;
+
+	if (match(p, TOKEN_COMMA)) {
+		advance(p);
+		byte_width = primitive_byte_width(advance(p)->type);
+		if (!byte_width)
+			return -EINVAL;
+	}
+
+	if (!consume(p, TOKEN_RBRACKET, "expected ']'"))
+		return -EINVAL;
+
+	ret = new_node(p, NODE_LEN);
+	target = arena_strndup(p->arena, tok->data.identifier.start, tok->data.identifier.length);
+	if (!ret || !target)
+		return -ENOMEM;
+
+	ret->data.len.target = target;
+	ret->data.len.byte_width = byte_width;
+	*node_ret = ret;
+	return 0;
+}
+
 static int parse_type(struct parser *p, struct ast_node **node_ret)
 {
 	if (is_primitive(peek(p)))
@@ -136,9 +215,13 @@ static int parse_type(struct parser *p, struct ast_node **node_ret)
 	if (peek(p)->type == TOKEN_KEYWORD_ARR)
 		return parse_arr(p, node_ret);
 
+	if (peek(p)->type == TOKEN_KEYWORD_LEN)
+		return parse_len(p, node_ret);
+
 	return -EINVAL;
 }
 
+/* Nodes are allocated from the parser's arena, so failure paths need not free them. */
 static int parse_region(struct parser *p, struct ast_node **node_ret)
 {
 	struct token *tok, *identifier;
@@ -146,53 +229,40 @@ static int parse_region(struct parser *p, struct ast_node **node_ret)
 	struct ast_node *node;
 	struct ast_node *ret;
 	int err;
-	int i;
 
 	identifier = consume(p, TOKEN_IDENTIFIER, "expected identifier");
 	if (!identifier)
 		return -EINVAL;
 
-	ret = malloc(sizeof(*ret));
+	ret = new_node(p, NODE_REGION);
 	if (!ret)
 		return -ENOMEM;
 
 	tok = advance(p);
 	if (tok->type != TOKEN_LBRACE)
-		goto fail_early;
+		return -EINVAL;
 
 	region = &ret->data.region;
-	region->name = strndup(identifier->data.identifier.start, identifier->data.identifier.length);
-	if (!region->name) {
-		err = -ENOMEM;
-		goto fail_early;
-	}
+	region->name = arena_strndup(p->arena, identifier->data.identifier.start, identifier->data.identifier.length);
+	if (!region->name)
+		return -ENOMEM;
 
+	region->members = NULL;
 	region->num_members = 0;
 	while (!match(p, TOKEN_RBRACE)) {
 		err = parse_type(p, &node);
 		if (err)
-			goto fail;
-		region->members = realloc(region->members, ++region->num_members * sizeof(struct ast_node *));
-		region->members[region->num_members - 1] = node;
+			return err;
+		err = append_node(p, &region->members, &region->num_members, node);
+		if (err)
+			return err;
 	}
 
-	if (!consume(p, TOKEN_RBRACE, "expected '}'") || !consume(p, TOKEN_SEMICOLON, "expected ';'")) {
-		err = -EINVAL;
-		goto fail;
-	}
+	if (!consume(p, TOKEN_RBRACE, "expected '}'") || !consume(p, TOKEN_SEMICOLON, "expected ';'"))
+		return -EINVAL;
 
-	ret->type = NODE_REGION;
 	*node_ret = ret;
 	return 0;
-
-fail:
-	for (i = 0; i < region->num_members; i++)
-		free(region->members[i]);
-	free((void *)region->name);
-	free(region->members);
-fail_early:
-	free(ret);
-	return err;
 }
 
 static int parse_program(struct parser *p, struct ast_node **node_ret)
@@ -200,14 +270,11 @@ static int parse_program(struct parser *p, struct ast_node **node_ret)
 	struct ast_program *prog;
 	struct ast_node *reg;
 	struct ast_node *ret;
-	void *new_ptr;
 	int err;
-	int i;
 
-	ret = malloc(sizeof(*ret));
+	ret = new_node(p, NODE_PROGRAM);
 	if (!ret)
 		return -ENOMEM;
-	ret->type = NODE_PROGRAM;
 
 	prog = &ret->data.program;
 	prog->num_members = 0;
@@ -215,41 +282,23 @@ static int parse_program(struct parser *p, struct ast_node **node_ret)
 	while (!match(p, TOKEN_EOF)) {
 		err = parse_region(p, &reg);
 		if (err)
-			goto fail;
-
-		new_ptr = realloc(prog->members, ++prog->num_members * sizeof(struct ast_node *));
-		if (!new_ptr) {
-			err = -ENOMEM;
-			goto fail;
-		}
-		prog->members = new_ptr;
-		prog->members[prog->num_members - 1] = reg;
+			return err;
+		err = append_node(p, &prog->members, &prog->num_members, reg);
+		if (err)
+			return err;
 	}
 
 	*node_ret = ret;
 	return 0;
-
-fail:
-	for (i = 0; i < prog->num_members; i++)
-		free(prog->members[i]);
-	free(prog->members);
-	free(ret);
-	return err;
 }
 
 size_t node_alignment(struct ast_node *node)
 {
-	int max_alignment = 1;
-
 	switch (node->type) {
 	case NODE_PROGRAM:
-		for (int i = 0; i < node->data.program.num_members; i++)
-			max_alignment = MAX(max_alignment, node_alignment(node->data.program.members[i]));
-		return max_alignment;
+		return node->data.program.alignment;
 	case NODE_REGION:
-		for (int i = 0; i < node->data.region.num_members; i++)
-			max_alignment = MAX(max_alignment, node_alignment(node->data.region.members[i]));
-		return max_alignment;
+		return node->data.region.alignment;
 	case NODE_ARRAY:
 		return node->data.array.elem_size;
 	case NODE_PRIMITIVE:
@@ -257,6 +306,8 @@ size_t node_alignment(struct ast_node *node)
 		return node->data.primitive.byte_width;
 	case NODE_POINTER:
 		return sizeof(uintptr_t);
+	case NODE_LEN:
+		return node->data.len.byte_width;
 	}
 
 	/* Anything should be at least 1-byte-aligned. */
@@ -265,29 +316,156 @@ size_t node_alignment(struct ast_node *node)
 
 size_t node_size(struct ast_node *node)
 {
-	size_t total = 0;
-
 	switch (node->type) {
 	case NODE_PROGRAM:
-		for (int i = 0; i < node->data.program.num_members; i++)
-			total += node_size(node->data.program.members[i]);
-		return total;
+		return node->data.program.size;
 	case NODE_REGION:
-		for (int i = 0; i < node->data.region.num_members; i++)
-			total += node_size(node->data.region.members[i]);
-		return total;
+		return node->data.region.size;
 	case NODE_ARRAY:
 		return node->data.array.elem_size * node->data.array.num_elems;
 	case NODE_PRIMITIVE:
 		return node->data.primitive.byte_width;
 	case NODE_POINTER:
 		return sizeof(uintptr_t);
+	case NODE_LEN:
+		return node->data.len.byte_width;
 	}
 	return 0;
 }
 
-int parse(struct token **tokens, size_t token_count, struct ast_node **node_ret)
+/* FNV-1a, to index region names. */
+static size_t hash_name(const char *name)
 {
-	struct parser p = { .tokens = tokens, .token_count = token_count, .curr_token = 0 };
-	return parse_program(&p, node_ret);
+	size_t hash = 2166136261u;
+
+	for (; *name; name++)
+		hash = (hash ^ (unsigned char)*name) * 16777619u;
+	return hash;
+}
+
+/*
+ * Returns the slot of @table holding the region named @name, or the free slot
+ * where it belongs. Slots hold a region's index plus one, so that zero marks
+ * a free slot.
+ */
+static size_t find_slot(struct ast_program *prog, const size_t *table, size_t table_size, const char *name)
+{
+	size_t slot;
+
+	for (slot = hash_name(name) & (table_size - 1); table[slot]; slot = (slot + 1) & (table_size - 1)) {
+		if (strcmp(prog->members[table[slot] - 1]->data.region.name, name) == 0)
+			break;
+	}
+	return slot;
+}
+
+/* Returns the index of the region named @name, or prints an error and returns -ENOENT. */
+static ssize_t lookup_region(struct ast_program *prog, const size_t *table, size_t table_size, const char *name)
+{
+	size_t slot = find_slot(prog, table, table_size, name);
+
+	if (!table[slot]) {
+		printf("parser failure: no region named %s\n", name);
+		return -ENOENT;
+	}
+	return table[slot] - 1;
+}
+
+/*
+ * Resolves every pointer and length field to the index of its region, and
+ * computes the sizes and alignments of every region and of the program. Region
+ * names are looked up in an open-addressing hash table, so this is linear in
+ * the size of the AST. As before, the first of several regions sharing a name
+ * wins.
+ */
+static int resolve_program(struct parser *p, struct ast_program *prog)
+{
+	struct ast_region *reg, *target;
+	struct ast_node *child;
+	size_t table_size = 1;
+	size_t *table;
+	size_t i, j, slot;
+	ssize_t index;
+
+	while (table_size < 2 * prog->num_members)
+		table_size *= 2;
+	table = arena_alloc(p->arena, table_size * sizeof(size_t));
+	if (!table)
+		return -ENOMEM;
+	memset(table, 0, table_size * sizeof(size_t));
+
+	for (i = 0; i < prog->num_members; i++) {
+		slot = find_slot(prog, table, table_size, prog->members[i]->data.region.name);
+		if (!table[slot])
+			table[slot] = i + 1;
+	}
+
+	prog->size = 0;
+	prog->alignment = 1;
+	for (i = 0; i < prog->num_members; i++) {
+		reg = &prog->members[i]->data.region;
+		reg->size = 0;
+		reg->alignment = 1;
+		for (j = 0; j < reg->num_members; j++) {
+			child = reg->members[j];
+			reg->size = round_up(reg->size, node_alignment(child)) + node_size(child);
+			reg->alignment = MAX(reg->alignment, node_alignment(child));
+			if (child->type == NODE_POINTER) {
+				index = lookup_region(prog, table, table_size, child->data.pointer.points_to);
+				if (index < 0)
+					return index;
+				child->data.pointer.region = index;
+			} else if (child->type == NODE_LEN) {
+				index = lookup_region(prog, table, table_size, child->data.len.target);
+				if (index < 0)
+					return index;
+				target = &prog->members[index]->data.region;
+				child->data.len.region = index;
+				child->data.len.unit = 1;
+				if (target->num_members == 1 && target->members[0]->type == NODE_ARRAY)
+					child->data.len.unit = target->members[0]->data.array.elem_size;
+			}
+		}
+		/* Regions are laid out like C structs, padding included. */
+		reg->size = round_up(reg->size, reg->alignment);
+		prog->size += reg->size;
+		prog->alignment = MAX(prog->alignment, reg->alignment);
+	}
+	return 0;
+}
+
+int parse(struct token **tokens, size_t token_count, struct arena *arena, struct ast_node **node_ret)
+{
+	struct parser p = { .tokens = tokens, .token_count = token_count, .curr_token = 0, .arena = arena };
+	int err;
+
+	if ((err = parse_program(&p, node_ret)))
+		return err;
+	return resolve_program(&p, &(*node_ret)->data.program);
+}
+
+int compile_schema(const char *input_fmt, struct arena *arena, struct ast_node **node_ret)
+{
+	struct arena *token_arena;
+	struct token **tokens;
+	size_t num_tokens;
+	int err;
+
+	/* Tokens are only needed while parsing. */
+	token_arena = new_arena(SCHEMA_ARENA_CHUNK_SIZE);
+	if (!token_arena)
+		return -ENOMEM;
+
+	err = tokenize(input_fmt, token_arena, &tokens, &num_tokens);
+	if (err) {
+		printf("tokenization failed: %s\n", strerror(-err));
+		goto out;
+	}
+
+	err = parse(tokens, num_tokens, arena, node_ret);
+	if (err)
+		printf("parsing failed: %s\n", strerror(-err));
+out:
+	destroy_arena(token_arena);
+	return err;
 }
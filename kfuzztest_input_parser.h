@@ -9,36 +9,69 @@
 
 #include <stdlib.h>
 
+#include "arena.h"
+
 enum ast_node_type {
 	NODE_PROGRAM,
 	NODE_REGION,
 	NODE_ARRAY,
 	NODE_PRIMITIVE,
 	NODE_POINTER,
+	NODE_LEN,
 };
 
 struct ast_node; /* Forward declaration. */
 
+/*
+ * The sizes and alignments of programs and regions are computed once by
+ * parse(), so that node_size() and node_alignment() never recurse. Regions
+ * holding ranged arrays take their largest size.
+ */
 struct ast_program {
 	struct ast_node **members;
 	size_t num_members;
+	size_t size;
+	size_t alignment;
 };
 
 struct ast_region {
 	const char *name;
 	struct ast_node **members;
 	size_t num_members;
+	size_t size;
+	size_t alignment;
 };
 
+/* @region is the index of the region named @points_to, resolved by parse(). */
 struct ast_pointer {
 	const char *points_to;
+	size_t region;
 };
 
+/*
+ * A fixed array has @num_elems elements. A ranged array, written
+ * arr[<type>, <min>..<max>], has between @min_elems and @num_elems, drawn anew
+ * for every input. Fixed arrays have @min_elems equal to @num_elems.
+ */
 struct ast_array {
 	int elem_size;
+	size_t min_elems;
 	size_t num_elems;
 };
 
+/*
+ * A field holding the length of the region named @target, resolved to its
+ * index @region by parse(). The length of a region made of a single array is
+ * its number of elements, so @unit is the array's element size; any other
+ * region's length is its size in bytes, and @unit is 1.
+ */
+struct ast_len {
+	const char *target;
+	size_t region;
+	size_t unit;
+	int byte_width;
+};
+
 struct ast_primitive {
 	int byte_width;
 };
@@ -51,6 +84,7 @@ struct ast_node {
 		struct ast_primitive primitive;
 		struct ast_array array;
 		struct ast_pointer pointer;
+		struct ast_len len;
 	} data;
 };
 
@@ -58,9 +92,41 @@ struct parser {
 	struct token **tokens;
 	size_t token_count;
 	size_t curr_token;
+	struct arena *arena;
 };
 
-int parse(struct token **tokens, size_t token_count, struct ast_node **node_ret);
+/**
+ * parse - build the AST of a tokenized input description
+ *
+ * @tokens: the tokens, ending with TOKEN_EOF.
+ * @token_count: the number of tokens.
+ * @arena: the arena that the AST is allocated from. The AST does not refer
+ *	to the tokens, which may be released once this returns.
+ * @node_ret: return pointer for the root of the AST.
+ *
+ * Every pointer and length field is resolved to the region it refers to, in
+ * time linear in the size of the input description.
+ *
+ * @return 0 on success, -ENOENT if a pointer or length field refers to a
+ * region that does not exist, or another negative errno on failure.
+ */
+int parse(struct token **tokens, size_t token_count, struct arena *arena, struct ast_node **node_ret);
+
+/* Chunk size of the arenas that compiled schemas and their tokens live in. */
+#define SCHEMA_ARENA_CHUNK_SIZE 4096
+
+/**
+ * compile_schema - tokenize and parse a textual input description
+ *
+ * @input_fmt: the textual description of the input format.
+ * @arena: the arena that the AST is allocated from, which must outlive every
+ *	use of the AST. Tokens are kept in a temporary arena of their own.
+ * @node_ret: return pointer for the root of the AST.
+ *
+ * @return 0 on success or a negative errno on failure, in which case the
+ * failing stage is reported on stdout.
+ */
+int compile_schema(const char *input_fmt, struct arena *arena, struct ast_node **node_ret);
 
 size_t node_size(struct ast_node *node);
 size_t node_alignment(struct ast_node *node);
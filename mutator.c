@@ -0,0 +1,133 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * In-place, field-granular mutation of encoded inputs
+ *
+ * Copyright 2025 Google LLC
+ */
+#include <asm-generic/errno-base.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "byte_order.h"
+#include "mutator.h"
+
+enum mutation {
+	MUTATE_FLIP_BIT,
+	MUTATE_ARITH,
+	MUTATE_SPLICE,
+	MUTATE_OVERWRITE,
+	MUTATE_RANDOMIZE,
+	/* Only drawn with a dictionary, so it comes last. */
+	MUTATE_INTERESTING,
+	NUM_MUTATIONS,
+};
+
+/* Draws a number in [0, @n) from @r, or 0 if @n is 0. */
+static int rand_below(struct rand_stream *r, uint64_t n, uint64_t *ret)
+{
+	uint64_t value;
+	int err;
+
+	if ((err = next_bytes(r, (char *)&value, sizeof(value))))
+		return err;
+	*ret = n ? value % n : 0;
+	return 0;
+}
+
+/* The width of the elements of a field: the primitive itself, or an array's elements. */
+static size_t elem_size(const struct ast_node *field)
+{
+	return field->type == NODE_ARRAY ? field->data.array.elem_size : field->data.primitive.byte_width;
+}
+
+/* Picks the length of a run of bytes in a field of @len bytes, which must not be 0. */
+static int run_len(struct rand_stream *r, size_t len, uint64_t *ret)
+{
+	int err;
+
+	if ((err = rand_below(r, len < MUTATE_MAX_RUN ? len : MUTATE_MAX_RUN, ret)))
+		return err;
+	++*ret;
+	return 0;
+}
+
+static int mutate_field(const struct template_field *fields, size_t num_fields, const struct dictionary *dict,
+			struct rand_stream *r, char *buf)
+{
+	const struct template_field *field;
+	const struct template_field *src;
+	uint64_t which, op, pos, len, src_pos, delta, bits;
+	size_t width;
+	char *dst;
+	int err;
+
+	if ((err = rand_below(r, num_fields, &which)) || (err = rand_below(r, dict ? NUM_MUTATIONS : MUTATE_INTERESTING, &op)))
+		return err;
+	field = &fields[which];
+	dst = buf + field->span.offset;
+	if (!field->span.len)
+		return 0;
+
+	switch (op) {
+	case MUTATE_FLIP_BIT:
+		if ((err = rand_below(r, field->span.len * 8, &pos)))
+			return err;
+		dst[pos / 8] ^= 1 << (pos % 8);
+		break;
+	case MUTATE_ARITH:
+		width = elem_size(field->node);
+		if ((err = rand_below(r, field->span.len / width, &pos)) ||
+		    (err = rand_below(r, 2 * MUTATE_ARITH_MAX, &delta)))
+			return err;
+		/* Maps [0, 2 * MUTATE_ARITH_MAX) to [-MUTATE_ARITH_MAX, MUTATE_ARITH_MAX], skipping 0. */
+		dst += pos * width;
+		store_le(dst, width, load_le(dst, width) + delta - MUTATE_ARITH_MAX + (delta >= MUTATE_ARITH_MAX));
+		break;
+	case MUTATE_SPLICE:
+		if ((err = rand_below(r, num_fields, &which)))
+			return err;
+		src = &fields[which];
+		if (!src->span.len)
+			return 0;
+		if ((err = run_len(r, src->span.len < field->span.len ? src->span.len : field->span.len, &len)))
+			return err;
+		if ((err = rand_below(r, src->span.len - len + 1, &src_pos)) ||
+		    (err = rand_below(r, field->span.len - len + 1, &pos)))
+			return err;
+		/* The source may be the field itself. */
+		memmove(dst + pos, buf + src->span.offset + src_pos, len);
+		break;
+	case MUTATE_OVERWRITE:
+		if ((err = run_len(r, field->span.len, &len)) ||
+		    (err = rand_below(r, field->span.len - len + 1, &pos)))
+			return err;
+		return next_bytes(r, dst + pos, len);
+	case MUTATE_RANDOMIZE:
+		return next_bytes(r, dst, field->span.len);
+	case MUTATE_INTERESTING:
+		width = elem_size(field->node);
+		if ((err = rand_below(r, field->span.len / width, &pos)) ||
+		    (err = next_bytes(r, (char *)&bits, sizeof(bits))))
+			return err;
+		store_le(dst + pos * width, width, dictionary_pick(dict, width, bits));
+		break;
+	}
+	return 0;
+}
+
+int mutate(const struct template_field *fields, size_t num_fields, const struct dictionary *dict,
+	   struct rand_stream *r, char *buf)
+{
+	uint64_t stack;
+	int err;
+
+	if (!num_fields)
+		return 0;
+	if ((err = rand_below(r, MUTATE_MAX_STACK, &stack)))
+		return err;
+	for (stack++; stack; stack--) {
+		if ((err = mutate_field(fields, num_fields, dict, r, buf)))
+			return err;
+	}
+	return 0;
+}
@@ -0,0 +1,51 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * In-place, field-granular mutation of encoded inputs
+ *
+ * Copyright 2025 Google LLC
+ */
+#ifndef MUTATOR_H
+#define MUTATOR_H 1
+
+#include "dictionary.h"
+#include "kfuzztest_encoder.h"
+#include "rand_stream.h"
+
+/* Number of inputs derived from each freshly encoded one, unless told otherwise. */
+#define MUTATE_DEFAULT_INPUTS 64
+
+/* Maximum number of mutations stacked on top of each other in one input. */
+#define MUTATE_MAX_STACK 4
+
+/* Largest amount added to or subtracted from an element by an arithmetic mutation. */
+#define MUTATE_ARITH_MAX 35
+
+/* Longest run of bytes spliced or overwritten by a single mutation. */
+#define MUTATE_MAX_RUN 256
+
+/**
+ * mutate - mutate the fields of an encoded input in place
+ *
+ * @fields: where the primitives and arrays of the input are: its template's
+ *	fields, or for schemas with ranged arrays, those of the input itself.
+ * @num_fields: the number of @fields.
+ * @dict: if set, the interesting values that elements may be set to.
+ * @r: the byte source that mutations are drawn from.
+ * @buf: the input.
+ *
+ * Applies between 1 and MUTATE_MAX_STACK mutations, each to a single field
+ * picked at random. A mutation either flips one bit, adds a small amount to
+ * or subtracts it from one element, splices a run of bytes in from another
+ * field, overwrites a run of bytes from @r, refills the whole field from
+ * @r, or sets one element to a value of @dict. The header, tables, padding,
+ * pointers and length fields are never touched, and neither is the length of
+ * a ranged array, so a mutation costs the size of the bytes it changes, not
+ * the size of the input.
+ *
+ * @return 0 on success, or a negative errno on failure, e.g. -ENODATA once
+ * @r is exhausted, in which case @buf may be partially mutated.
+ */
+int mutate(const struct template_field *fields, size_t num_fields, const struct dictionary *dict,
+	   struct rand_stream *r, char *buf);
+
+#endif /* MUTATOR_H */
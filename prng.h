@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Fast, seedable, non-cryptographic pseudo-random number generators
+ *
+ * Copyright 2025 Google LLC
+ */
+#ifndef PRNG_H
+#define PRNG_H 1
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PRNG_LANES 4
+
+/* Number of bytes produced by one step of a struct prng. */
+#define PRNG_BLOCK_SIZE (PRNG_LANES * sizeof(uint64_t))
+
+/* splitmix64, used on its own where quality matters little, and for seeding. */
+static inline uint64_t splitmix64(uint64_t *state)
+{
+	uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return z ^ (z >> 31);
+}
+
+/**
+ * struct prng - PRNG_LANES independent xoshiro256** generators
+ *
+ * The lanes are stored as a structure of arrays and stepped in lockstep, so
+ * that the compiler can keep one lane per element of a vector register and
+ * produce a whole PRNG_BLOCK_SIZE block with wide stores.
+ */
+struct prng {
+	uint64_t s0[PRNG_LANES];
+	uint64_t s1[PRNG_LANES];
+	uint64_t s2[PRNG_LANES];
+	uint64_t s3[PRNG_LANES];
+};
+
+/**
+ * prng_seed - seed a struct prng
+ *
+ * @p: the generator.
+ * @seed: the run's seed.
+ * @stream: selects one of 2^64 independent streams for @seed.
+ */
+static inline void prng_seed(struct prng *p, uint64_t seed, uint64_t stream)
+{
+	uint64_t sm = seed ^ splitmix64(&stream);
+	int i;
+
+	for (i = 0; i < PRNG_LANES; i++) {
+		p->s0[i] = splitmix64(&sm);
+		p->s1[i] = splitmix64(&sm);
+		p->s2[i] = splitmix64(&sm);
+		p->s3[i] = splitmix64(&sm);
+	}
+}
+
+static inline uint64_t prng_rotl(uint64_t x, int k)
+{
+	return (x << k) | (x >> (64 - k));
+}
+
+/**
+ * prng_fill - fill a buffer with pseudo-random bytes
+ *
+ * @p: the generator.
+ * @buf: the destination.
+ * @len: the size of @buf, a multiple of PRNG_BLOCK_SIZE.
+ */
+static inline void prng_fill(struct prng *p, char *buf, size_t len)
+{
+	uint64_t out[PRNG_LANES];
+	uint64_t t;
+	size_t off;
+	int i;
+
+	for (off = 0; off < len; off += PRNG_BLOCK_SIZE) {
+		for (i = 0; i < PRNG_LANES; i++) {
+			out[i] = prng_rotl(p->s1[i] * 5, 7) * 9;
+			t = p->s1[i] << 17;
+			p->s2[i] ^= p->s0[i];
+			p->s3[i] ^= p->s1[i];
+			p->s1[i] ^= p->s2[i];
+			p->s0[i] ^= p->s3[i];
+			p->s2[i] ^= t;
+			p->s3[i] = prng_rotl(p->s3[i], 45);
+		}
+		memcpy(buf + off, out, PRNG_BLOCK_SIZE);
+	}
+}
+
+#endif /* PRNG_H */
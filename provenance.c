@@ -0,0 +1,112 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Input provenance: where each field of an encoded input came from
+ *
+ * Copyright 2025 Google LLC
+ */
+#include <asm-generic/errno-base.h>
+#include <errno.h>
+#include <string.h>
+
+#include "provenance.h"
+#include "stats.h"
+
+struct provenance *new_provenance(const char *target)
+{
+	struct provenance *p;
+
+	p = calloc(1, sizeof(*p));
+	if (!p)
+		return NULL;
+	p->target = stats_escape_label(target, STATS_FORMAT_JSON);
+	if (!p->target) {
+		free(p);
+		return NULL;
+	}
+	return p;
+}
+
+void destroy_provenance(struct provenance *p)
+{
+	free(p->entries);
+	free(p->target);
+	free(p);
+}
+
+int provenance_add(struct provenance *p, struct provenance_entry entry)
+{
+	size_t new_alloc;
+	void *new_ptr;
+
+	if (p->num_entries == p->alloc_entries) {
+		new_alloc = p->alloc_entries ? 2 * p->alloc_entries : 16;
+		new_ptr = realloc(p->entries, new_alloc * sizeof(struct provenance_entry));
+		if (!new_ptr)
+			return -ENOMEM;
+		p->entries = new_ptr;
+		p->alloc_entries = new_alloc;
+	}
+	p->entries[p->num_entries++] = entry;
+	return 0;
+}
+
+struct provenance_log *new_provenance_log(const char *path)
+{
+	struct provenance_log *log;
+
+	log = malloc(sizeof(*log));
+	if (!log)
+		return NULL;
+	log->file = fopen(path, "w");
+	if (!log->file) {
+		free(log);
+		return NULL;
+	}
+	pthread_mutex_init(&log->lock, NULL);
+	return log;
+}
+
+int destroy_provenance_log(struct provenance_log *log)
+{
+	int err = 0;
+
+	if (fclose(log->file))
+		err = -errno;
+	pthread_mutex_destroy(&log->lock);
+	free(log);
+	return err;
+}
+
+/* Prints a field's type in the schema's own syntax, e.g. "u32", "arr[u8, 16]" or "arr[u8, 0..16]". */
+static void print_field_type(FILE *f, const struct ast_node *field)
+{
+	if (field->type == NODE_ARRAY && field->data.array.min_elems != field->data.array.num_elems)
+		fprintf(f, "arr[u%d, %zu..%zu]", field->data.array.elem_size * 8, field->data.array.min_elems,
+			field->data.array.num_elems);
+	else if (field->type == NODE_ARRAY)
+		fprintf(f, "arr[u%d, %zu]", field->data.array.elem_size * 8, field->data.array.num_elems);
+	else if (field->type == NODE_PRIMITIVE)
+		fprintf(f, "u%d", field->data.primitive.byte_width * 8);
+	else
+		fprintf(f, "?");
+}
+
+void provenance_log_input(struct provenance_log *log, const struct provenance *p, uint64_t input,
+			  size_t input_size)
+{
+	const struct provenance_entry *e;
+	size_t i;
+
+	pthread_mutex_lock(&log->lock);
+	fprintf(log->file, "{\"target\":\"%s\",\"input\":%llu,\"size\":%zu,\"payload_offset\":%zu,\"fields\":[",
+		p->target, (unsigned long long)input, input_size, p->payload_offset);
+	for (i = 0; i < p->num_entries; i++) {
+		e = &p->entries[i];
+		fprintf(log->file, "%s{\"src\":%llu,\"len\":%zu,\"region\":\"%s\",\"member\":%zu,\"type\":\"",
+			i ? "," : "", (unsigned long long)e->src_offset, e->src_len, e->region, e->member);
+		print_field_type(log->file, e->field);
+		fprintf(log->file, "\",\"offset\":%zu%s}", e->payload_offset, e->choice ? ",\"choice\":true" : "");
+	}
+	fprintf(log->file, "]}\n");
+	pthread_mutex_unlock(&log->lock);
+}
@@ -0,0 +1,114 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Input provenance: where each field of an encoded input came from
+ *
+ * Copyright 2025 Google LLC
+ */
+#ifndef PROVENANCE_H
+#define PROVENANCE_H 1
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "kfuzztest_input_parser.h"
+
+/**
+ * struct provenance_entry - source bytes that went into one field
+ *
+ * @src_offset: offset of the field's first byte in the byte source, see
+ *	struct rand_stream's @offset.
+ * @src_len: number of bytes the field took from the byte source.
+ * @region: name of the region holding the field.
+ * @member: index of the field among the region's members.
+ * @field: the field's AST node, which gives its type.
+ * @payload_offset: offset of the field in the encoded input's payload.
+ * @choice: whether the bytes chose whether, and how, to replace the field with
+ *	an interesting value, rather than being copied to it.
+ */
+struct provenance_entry {
+	uint64_t src_offset;
+	size_t src_len;
+	const char *region;
+	size_t member;
+	const struct ast_node *field;
+	size_t payload_offset;
+	bool choice;
+};
+
+/**
+ * struct provenance - side-table mapping source bytes to an input's fields
+ *
+ * @target: name of the target the input is for, used to label the table.
+ *	Escaped for use in a JSON string.
+ * @entries: one entry per field that took bytes from the source, in source
+ *	order, followed by the choice entries of interesting values. Pointers
+ *	take none, since KFuzzTest patches them.
+ * @num_entries: the number of valid @entries.
+ * @alloc_entries: the capacity of @entries, which is kept across inputs.
+ * @payload_offset: offset of the payload in the encoded input.
+ *
+ * Filled in by encode(), which resets the table first.
+ */
+struct provenance {
+	char *target;
+	struct provenance_entry *entries;
+	size_t num_entries;
+	size_t alloc_entries;
+	size_t payload_offset;
+};
+
+struct provenance *new_provenance(const char *target);
+
+void destroy_provenance(struct provenance *p);
+
+int provenance_add(struct provenance *p, struct provenance_entry entry);
+
+/**
+ * struct provenance_log - a file that provenance tables are appended to
+ *
+ * @file: the log, holding one JSON object per line.
+ * @lock: serializes workers appending to @file.
+ */
+struct provenance_log {
+	FILE *file;
+	pthread_mutex_t lock;
+};
+
+/**
+ * new_provenance_log - create a provenance log
+ *
+ * @path: the file to write.
+ *
+ * @return the new log, or NULL on failure.
+ */
+struct provenance_log *new_provenance_log(const char *path);
+
+/**
+ * destroy_provenance_log - flush and close a provenance log
+ *
+ * @return 0 on success or a negative errno if buffered output was lost.
+ */
+int destroy_provenance_log(struct provenance_log *log);
+
+/**
+ * provenance_log_input - append one input's provenance table to a log
+ *
+ * @log: the log.
+ * @p: the table filled in by encode().
+ * @input: the number of the input.
+ * @input_size: the size of the encoded input in bytes.
+ *
+ * Writes a line such as
+ *
+ *	{"target":"t","input":3,"size":96,"payload_offset":48,"fields":[
+ *	 {"src":0,"len":4,"region":"foo","member":0,"type":"u32","offset":0},...]}
+ *
+ * without the line break. Choice entries also have "choice":true.
+ */
+void provenance_log_input(struct provenance_log *log, const struct provenance *p, uint64_t input,
+			  size_t input_size);
+
+#endif /* PROVENANCE_H */
@@ -5,27 +5,148 @@
  *
  * Copyright 2025 Google LLC
  */
+#include <asm-generic/errno-base.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "prng.h"
 #include "rand_stream.h"
+#include "read_ahead.h"
+
+/*
+ * Bytes generated ahead by a RAND_STREAM_PRNG stream. Small, because the
+ * stream is reseeded for every input, and most inputs are short.
+ */
+#define PRNG_BUFFER_SIZE (16 * PRNG_BLOCK_SIZE)
+
+/* Served in place of the source once a zero-padded stream is exhausted. */
+static char zero_page[4096];
 
 static int refill(struct rand_stream *rs)
 {
-	size_t ret = fread(rs->buffer, sizeof(char), rs->buffer_size, rs->source);
+	size_t ret;
+
+	if (rs->type == RAND_STREAM_PRNG) {
+		prng_fill(rs->prng, rs->buffer, rs->buffer_size);
+		rs->buffer_pos = 0;
+		return 0;
+	}
+
+	if (rs->type == RAND_STREAM_READ_AHEAD) {
+		rs->buffer_pos = 0;
+		return read_ahead_next(rs->ra, &rs->buffer);
+	}
+
+	if (rs->type != RAND_STREAM_FILE) {
+		if (!rs->zero_pad)
+			return -ENODATA;
+		rs->buffer = zero_page;
+		rs->buffer_size = sizeof(zero_page);
+		rs->buffer_pos = 0;
+		return 0;
+	}
+
+	ret = fread(rs->buffer, sizeof(char), rs->buffer_size, rs->source);
 	rs->buffer_pos = 0;
 	if (ret != rs->buffer_size)
-		return -1;
+		return -ENODATA;
 	return 0;
 }
 
-struct rand_stream *new_rand_stream(const char *path_to_file, size_t cache_size)
+/*
+ * Maps the regular file behind @fd, which is closed in all cases. Bytes are
+ * then served straight from the page cache, without copies or refills.
+ */
+static struct rand_stream *map_rand_stream(int fd, size_t size, bool zero_pad)
 {
 	struct rand_stream *rs;
+	void *map = NULL;
+
+	if (size > 0) {
+		map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map == MAP_FAILED) {
+			close(fd);
+			return NULL;
+		}
+		/* Inputs are consumed front to back, so read ahead aggressively. */
+		madvise(map, size, MADV_SEQUENTIAL);
+	}
+	/* The mapping stays valid after the descriptor is closed. */
+	close(fd);
 
 	rs = malloc(sizeof(*rs));
-	if (!rs)
+	if (!rs) {
+		if (map)
+			munmap(map, size);
 		return NULL;
+	}
+
+	rs->type = RAND_STREAM_MMAP;
+	rs->source = NULL;
+	rs->map = map;
+	rs->map_size = size;
+	rs->buffer = map;
+	rs->buffer_size = size;
+	rs->buffer_pos = 0;
+	rs->zero_pad = zero_pad;
+	rs->prng = NULL;
+	rs->ra = NULL;
+	rs->offset = 0;
+	return rs;
+}
 
-	rs->source = fopen(path_to_file, "rb");
+struct rand_stream *new_rand_stream(const char *path_to_file, size_t cache_size, unsigned int read_ahead)
+{
+	struct rand_stream *rs;
+	struct stat st;
+	int fd;
+
+	fd = open(path_to_file, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, &st)) {
+		close(fd);
+		return NULL;
+	}
+	/* Pipes and devices such as /dev/urandom cannot be mapped. */
+	if (S_ISREG(st.st_mode) && st.st_size > 0)
+		return map_rand_stream(fd, st.st_size, false);
+
+	rs = malloc(sizeof(*rs));
+	if (!rs) {
+		close(fd);
+		return NULL;
+	}
+
+	rs->type = RAND_STREAM_FILE;
+	rs->map = NULL;
+	rs->zero_pad = false;
+	rs->prng = NULL;
+	rs->ra = NULL;
+	rs->offset = 0;
+	rs->buffer_size = cache_size;
+
+	if (read_ahead) {
+		rs->type = RAND_STREAM_READ_AHEAD;
+		rs->source = NULL;
+		rs->buffer = NULL;
+		rs->ra = new_read_ahead(fd, cache_size, read_ahead);
+		if (!rs->ra || refill(rs)) {
+			if (rs->ra)
+				destroy_read_ahead(rs->ra);
+			free(rs);
+			return NULL;
+		}
+		return rs;
+	}
+
+	rs->source = fdopen(fd, "rb");
 	if (!rs->source) {
+		close(fd);
 		free(rs);
 		return NULL;
 	}
@@ -37,7 +158,6 @@ struct rand_stream *new_rand_stream(const char *path_to_file, size_t cache_size)
 		return NULL;
 	}
 
-	rs->buffer_size = cache_size;
 	if (refill(rs)) {
 		free(rs->buffer);
 		fclose(rs->source);
@@ -48,6 +168,138 @@ struct rand_stream *new_rand_stream(const char *path_to_file, size_t cache_size)
 	return rs;
 }
 
+struct rand_stream *new_mmap_rand_stream(const char *path_to_file, bool zero_pad)
+{
+	struct stat st;
+	int fd;
+
+	fd = open(path_to_file, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, &st) || !S_ISREG(st.st_mode)) {
+		close(fd);
+		return NULL;
+	}
+	return map_rand_stream(fd, st.st_size, zero_pad);
+}
+
+void init_mem_rand_stream(struct rand_stream *rs, const char *buf, size_t size, bool zero_pad)
+{
+	rs->type = RAND_STREAM_MEMORY;
+	rs->source = NULL;
+	rs->map = NULL;
+	rs->map_size = 0;
+	rs->buffer = (char *)buf;
+	rs->buffer_size = size;
+	rs->buffer_pos = 0;
+	rs->zero_pad = zero_pad;
+	rs->prng = NULL;
+	rs->ra = NULL;
+	rs->offset = 0;
+}
+
+struct rand_stream *new_prng_rand_stream(uint64_t seed)
+{
+	struct rand_stream *rs;
+
+	rs = calloc(1, sizeof(*rs));
+	if (!rs)
+		return NULL;
+
+	rs->type = RAND_STREAM_PRNG;
+	rs->seed = seed;
+	rs->prng = malloc(sizeof(*rs->prng));
+	rs->buffer = malloc(PRNG_BUFFER_SIZE);
+	if (!rs->prng || !rs->buffer) {
+		free(rs->prng);
+		free(rs->buffer);
+		free(rs);
+		return NULL;
+	}
+	rs->buffer_size = PRNG_BUFFER_SIZE;
+	rand_stream_seek_input(rs, 0);
+	return rs;
+}
+
+void rand_stream_seek_input(struct rand_stream *rs, uint64_t input)
+{
+	if (rs->type != RAND_STREAM_PRNG)
+		return;
+	prng_seed(rs->prng, rs->seed, input);
+	rs->offset = 0;
+	/* Generate lazily, on the input's first byte. */
+	rs->buffer_pos = rs->buffer_size;
+}
+
+void destroy_rand_stream(struct rand_stream *rs)
+{
+	if (rs->type == RAND_STREAM_MMAP) {
+		if (rs->map)
+			munmap(rs->map, rs->map_size);
+	} else if (rs->type == RAND_STREAM_PRNG) {
+		free(rs->prng);
+		free(rs->buffer);
+	} else if (rs->type == RAND_STREAM_READ_AHEAD) {
+		destroy_read_ahead(rs->ra);
+	} else {
+		fclose(rs->source);
+		free(rs->buffer);
+	}
+	free(rs);
+}
+
+/*
+ * Produces the leading part of @len bytes directly into @dst, when the cache
+ * is empty and would only be copied through. The stream's bytes are the same
+ * either way. @return the number of bytes produced.
+ */
+static size_t fill_direct(struct rand_stream *rs, char *dst, size_t len)
+{
+	switch (rs->type) {
+	case RAND_STREAM_PRNG:
+		/* Cache refills generate whole blocks, so this stays in step. */
+		len -= len % PRNG_BLOCK_SIZE;
+		prng_fill(rs->prng, dst, len);
+		return len;
+	case RAND_STREAM_FILE:
+		if (len < rs->buffer_size)
+			return 0;
+		return fread(dst, sizeof(char), len, rs->source);
+	default:
+		return 0;
+	}
+}
+
+int next_bytes(struct rand_stream *rs, char *dst, size_t len)
+{
+	size_t avail;
+	size_t n;
+	int res;
+
+	rs->offset += len;
+	while (len > 0) {
+		avail = rs->buffer_size - rs->buffer_pos;
+		if (avail == 0) {
+			n = fill_direct(rs, dst, len);
+			if (rs->type == RAND_STREAM_FILE && n > 0 && n < len)
+				return -ENODATA;
+			dst += n;
+			len -= n;
+			if (len == 0)
+				break;
+			if ((res = refill(rs)))
+				return res;
+			avail = rs->buffer_size;
+		}
+		n = len < avail ? len : avail;
+		memcpy(dst, rs->buffer + rs->buffer_pos, n);
+		rs->buffer_pos += n;
+		dst += n;
+		len -= n;
+	}
+	return 0;
+}
+
 int next_byte(struct rand_stream *rs, char *ret)
 {
 	int res;
@@ -57,5 +309,6 @@ int next_byte(struct rand_stream *rs, char *ret)
 			return res;
 	}
 	*ret = rs->buffer[rs->buffer_pos++];
+	rs->offset++;
 	return 0;
 }
@@ -8,20 +8,63 @@
 #ifndef RAND_STREAM_H
 #define RAND_STREAM_H 1
 
+#include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
 
+/* Read-ahead cache size for sources that cannot be mapped. */
+#define RAND_STREAM_CACHE_SIZE 1024
+
+/* Defaults for sources read from a background thread, see new_rand_stream(). */
+#define RAND_STREAM_READ_AHEAD_SIZE (64 * 1024)
+#define RAND_STREAM_READ_AHEAD_DEPTH 2
+
+enum rand_stream_type {
+	RAND_STREAM_FILE,
+	RAND_STREAM_MMAP,
+	RAND_STREAM_MEMORY,
+	RAND_STREAM_PRNG,
+	RAND_STREAM_READ_AHEAD,
+};
+
+struct prng;
+struct read_ahead;
+
 /**
  * struct rand_stream - a cached bytestream reader
  *
  * Reads and returns bytes from a file, using cached pre-fetching to amortize
- * the cost of reads.
+ * the cost of reads. A RAND_STREAM_MMAP stream instead serves bytes directly
+ * from a mapping of the whole file, with @buffer pointing into the mapping.
+ * A RAND_STREAM_MEMORY stream serves bytes from a caller-owned buffer. A
+ * RAND_STREAM_PRNG stream generates its bytes, with @buffer holding the
+ * current block. A RAND_STREAM_READ_AHEAD stream reads like a RAND_STREAM_FILE
+ * one, but from a background thread, with @buffer pointing at the buffer that
+ * the thread filled last.
+ *
+ * @map, @map_size: the mapping backing a RAND_STREAM_MMAP stream.
+ * @zero_pad: once a RAND_STREAM_MMAP or RAND_STREAM_MEMORY stream is
+ *	exhausted, yield zero bytes rather than failing with -ENODATA.
+ * @prng, @seed: the generator behind a RAND_STREAM_PRNG stream, and the seed
+ *	from which every input's generator is derived.
+ * @ra: the reader thread behind a RAND_STREAM_READ_AHEAD stream.
+ * @offset: number of bytes served so far, or since the last
+ *	rand_stream_seek_input() for a RAND_STREAM_PRNG stream. Locates a byte
+ *	within the source.
  */
 struct rand_stream {
+	enum rand_stream_type type;
 	FILE *source;
+	char *map;
+	size_t map_size;
 	char *buffer;
 	size_t buffer_size;
 	size_t buffer_pos;
+	bool zero_pad;
+	struct prng *prng;
+	uint64_t seed;
+	struct read_ahead *ra;
+	uint64_t offset;
 };
 
 /**
@@ -29,8 +72,58 @@ struct rand_stream {
  *
  * @path_to_file: source of the output byte stream.
  * @cache_size: size of the read-ahead cache in bytes.
+ * @read_ahead: if at least 2, the number of @cache_size buffers that a
+ *	background thread keeps filled, so that the encoder does not stall on
+ *	a slow source. If 0, the cache is refilled synchronously.
+ *
+ * A non-empty regular file is mapped and read in place, as by
+ * new_mmap_rand_stream() without padding, and @cache_size and @read_ahead are
+ * unused. Other files, such as pipes or /dev/urandom, are read through the
+ * cache.
  */
-struct rand_stream *new_rand_stream(const char *path_to_file, size_t cache_size);
+struct rand_stream *new_rand_stream(const char *path_to_file, size_t cache_size, unsigned int read_ahead);
+
+/**
+ * new_mmap_rand_stream - return a struct rand_stream reading a mapped file
+ *
+ * @path_to_file: a regular file, which is mapped read-only in its entirety.
+ * @zero_pad: pad the file with zero bytes instead of failing once it is
+ *	exhausted.
+ */
+struct rand_stream *new_mmap_rand_stream(const char *path_to_file, bool zero_pad);
+
+/**
+ * init_mem_rand_stream - set up a struct rand_stream reading a buffer in place
+ *
+ * @rs: the stream to initialize. Needs no destroy_rand_stream().
+ * @buf: the source bytes, which must outlive @rs.
+ * @size: the size of @buf in bytes.
+ * @zero_pad: pad the buffer with zero bytes instead of failing once it is
+ *	exhausted.
+ */
+void init_mem_rand_stream(struct rand_stream *rs, const char *buf, size_t size, bool zero_pad);
+
+/**
+ * new_prng_rand_stream - return a struct rand_stream of pseudo-random bytes
+ *
+ * @seed: the seed. The bytes of every input are determined by @seed and the
+ *	input's number alone, see rand_stream_seek_input().
+ */
+struct rand_stream *new_prng_rand_stream(uint64_t seed);
+
+/**
+ * rand_stream_seek_input - start the bytes of a given input
+ *
+ * @rs: a struct rand_stream.
+ * @input: the number of the input about to be encoded.
+ *
+ * Reseeds a RAND_STREAM_PRNG stream so that the input's bytes do not depend
+ * on how many bytes earlier inputs consumed, which makes any input
+ * reproducible from (seed, input). Other streams are left untouched.
+ */
+void rand_stream_seek_input(struct rand_stream *rs, uint64_t input);
+
+void destroy_rand_stream(struct rand_stream *rs);
 
 /**
  * next_byte - return the next byte from a struct rand_stream
@@ -38,9 +131,25 @@ struct rand_stream *new_rand_stream(const char *path_to_file, size_t cache_size)
  * @rs: an initialized struct rand_stream.
  * @ret: return pointer.
  *
- * @return 0 on success or a negative value on failure.
- *
+ * @return 0 on success, -ENODATA once the source is exhausted, or another
+ * negative value on failure.
  */
 int next_byte(struct rand_stream *rs, char *ret);
 
+/**
+ * next_bytes - copy the next bytes of a struct rand_stream
+ *
+ * @rs: an initialized struct rand_stream.
+ * @dst: where to copy the bytes to.
+ * @len: the number of bytes to copy.
+ *
+ * Equivalent to @len calls to next_byte(), but moves whole runs of the cache
+ * or mapping with memcpy(). Runs that are not cached yet are generated or read
+ * straight into @dst where possible, skipping the cache altogether.
+ *
+ * @return 0 on success, -ENODATA once the source is exhausted, or another
+ * negative value on failure. @dst is then partially filled.
+ */
+int next_bytes(struct rand_stream *rs, char *dst, size_t len);
+
 #endif /* RAND_STREAM_H */
@@ -0,0 +1,132 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Background read-ahead for slow or streaming byte sources
+ *
+ * Copyright 2025 Google LLC
+ */
+#include <asm-generic/errno-base.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "handoff.h"
+#include "read_ahead.h"
+
+/* Reads until @buf is full or the source ends, like fread(). */
+static size_t read_full(int fd, char *buf, size_t size)
+{
+	size_t len = 0;
+	ssize_t ret;
+
+	while (len < size) {
+		ret = read(fd, buf + len, size - len);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			break;
+		len += ret;
+	}
+	return len;
+}
+
+static void *reader_thread(void *arg)
+{
+	struct read_ahead *ra = arg;
+	uint32_t head = ra->head;
+	unsigned int i;
+
+	for (;;) {
+		/* Wait for the consumer to release a buffer. */
+		wait_for_change(&ra->tail, head - ra->depth, &ra->reader_waiting);
+
+		i = head % ra->depth;
+		ra->lens[i] = read_full(ra->fd, ra->buffers[i], ra->buffer_size);
+		bump(&ra->head, &ra->consumer_waiting);
+		head++;
+		/* A short buffer ends the source. */
+		if (ra->lens[i] != ra->buffer_size)
+			return NULL;
+	}
+}
+
+struct read_ahead *new_read_ahead(int fd, size_t buffer_size, unsigned int depth)
+{
+	struct read_ahead *ra;
+	unsigned int i;
+
+	if (depth < 2 || posix_memalign((void **)&ra, __alignof__(struct read_ahead), sizeof(*ra))) {
+		close(fd);
+		return NULL;
+	}
+	*ra = (struct read_ahead){
+		.fd = fd,
+		.buffer_size = buffer_size,
+		.depth = depth,
+	};
+
+	ra->buffers = calloc(depth, sizeof(char *));
+	ra->lens = calloc(depth, sizeof(size_t));
+	if (!ra->buffers || !ra->lens)
+		goto fail;
+	for (i = 0; i < depth; i++) {
+		ra->buffers[i] = malloc(buffer_size);
+		if (!ra->buffers[i])
+			goto fail;
+	}
+
+	if (pthread_create(&ra->thread, NULL, reader_thread, ra))
+		goto fail;
+	return ra;
+
+fail:
+	if (ra->buffers) {
+		for (i = 0; i < depth; i++)
+			free(ra->buffers[i]);
+	}
+	free(ra->buffers);
+	free(ra->lens);
+	free(ra);
+	close(fd);
+	return NULL;
+}
+
+int read_ahead_next(struct read_ahead *ra, char **ret)
+{
+	unsigned int i;
+
+	if (ra->holding) {
+		/* A short buffer was the last one; the reader has exited. */
+		if (ra->lens[ra->tail % ra->depth] != ra->buffer_size)
+			return -ENODATA;
+		bump(&ra->tail, &ra->reader_waiting);
+		ra->holding = false;
+	}
+
+	wait_for_change(&ra->head, ra->tail, &ra->consumer_waiting);
+	i = ra->tail % ra->depth;
+	ra->holding = true;
+	if (ra->lens[i] != ra->buffer_size)
+		return -ENODATA;
+	*ret = ra->buffers[i];
+	return 0;
+}
+
+void destroy_read_ahead(struct read_ahead *ra)
+{
+	unsigned int i;
+
+	/*
+	 * The reader may be blocked reading the source indefinitely, which is a
+	 * cancellation point. If it is waiting for a buffer instead, free one up
+	 * so that it moves on to its next read.
+	 */
+	pthread_cancel(ra->thread);
+	__atomic_add_fetch(&ra->tail, ra->depth, __ATOMIC_SEQ_CST);
+	futex_wake(&ra->tail);
+	pthread_join(ra->thread, NULL);
+	close(ra->fd);
+	for (i = 0; i < ra->depth; i++)
+		free(ra->buffers[i]);
+	free(ra->buffers);
+	free(ra->lens);
+	free(ra);
+}
@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Background read-ahead for slow or streaming byte sources
+ *
+ * Copyright 2025 Google LLC
+ */
+#ifndef READ_AHEAD_H
+#define READ_AHEAD_H 1
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ * struct read_ahead - a reader thread filling a ring of buffers
+ *
+ * @fd: the source, read by the reader thread only.
+ * @buffer_size: the size of each buffer.
+ * @depth: the number of buffers.
+ * @buffers: the ring of buffers, each @buffer_size bytes long.
+ * @lens: the number of bytes read into each buffer. Only the last buffer of
+ *	the source is short.
+ * @head: number of buffers filled, written by the reader thread.
+ * @tail: number of buffers released, written by the consumer.
+ * @reader_waiting, @consumer_waiting: set by either side before it sleeps on
+ *	the other's counter, so that the other side only makes a syscall to wake
+ *	it when it has to.
+ * @holding: whether the consumer is reading buffer @tail.
+ * @thread: the reader thread.
+ *
+ * The ring has a single producer and a single consumer, which hand buffers
+ * over by bumping @head and @tail, so the consumer takes no lock and makes no
+ * syscall as long as the reader keeps ahead of it.
+ */
+struct read_ahead {
+	int fd;
+	size_t buffer_size;
+	unsigned int depth;
+	char **buffers;
+	size_t *lens;
+
+	uint32_t head __attribute__((aligned(64)));
+	uint32_t consumer_waiting;
+
+	uint32_t tail __attribute__((aligned(64)));
+	uint32_t reader_waiting;
+	bool holding;
+
+	pthread_t thread;
+};
+
+/**
+ * new_read_ahead - start reading a source ahead of its consumer
+ *
+ * @fd: the source, which is owned, and eventually closed, by the read-ahead.
+ * @buffer_size: the size of each buffer.
+ * @depth: the number of buffers, at least 2.
+ *
+ * @return the new read-ahead, or NULL on failure, in which case @fd is closed.
+ */
+struct read_ahead *new_read_ahead(int fd, size_t buffer_size, unsigned int depth);
+
+/**
+ * read_ahead_next - release the consumer's buffer and take the next one
+ *
+ * @ra: the read-ahead.
+ * @ret: set to a full buffer of @ra->buffer_size bytes, valid until the next
+ *	call.
+ *
+ * Waits for the reader thread if it has not filled the next buffer yet.
+ *
+ * @return 0 on success, or -ENODATA once the source is exhausted. As with a
+ * synchronous read, a trailing partial buffer is dropped.
+ */
+int read_ahead_next(struct read_ahead *ra, char **ret);
+
+void destroy_read_ahead(struct read_ahead *ra);
+
+#endif /* READ_AHEAD_H */
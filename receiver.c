@@ -0,0 +1,197 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Userspace reference receiver for KFuzzTest binary inputs
+ *
+ * Copyright 2025 Google LLC
+ */
+#include <asm-generic/errno-base.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "byte_order.h"
+#include "receiver.h"
+
+#ifdef __SANITIZE_ADDRESS__
+#include <sanitizer/asan_interface.h>
+#else
+#define ASAN_POISON_MEMORY_REGION(addr, size) ((void)(addr), (void)(size))
+#define ASAN_UNPOISON_MEMORY_REGION(addr, size) ((void)(addr), (void)(size))
+#endif
+
+/*
+ * The wire format, as the kernel reads it. It is deliberately not shared with
+ * the encoder, so that each checks the other.
+ */
+#define KFUZZTEST_MAGIC 0xBFACE
+#define KFUZZTEST_PROTO_VERSION 0
+#define KFUZZTEST_POISON_SIZE 8
+#define HEADER_SIZE (3 * sizeof(uint32_t))
+#define REGION_ENTRY_SIZE (2 * sizeof(uint32_t))
+#define RELOC_HEADER_SIZE (2 * sizeof(uint32_t))
+#define RELOC_ENTRY_SIZE (3 * sizeof(uint32_t))
+
+/* Alignment of the copy of each input, enough for any region. */
+#define RECEIVER_ALIGN 64
+
+struct receiver *new_receiver(void)
+{
+	return calloc(1, sizeof(struct receiver));
+}
+
+void destroy_receiver(struct receiver *r)
+{
+	if (r->buf)
+		ASAN_UNPOISON_MEMORY_REGION(r->buf, r->buf_size);
+	free(r->buf);
+	free(r->regions);
+	free(r);
+}
+
+static int reject(struct receiver *r, const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(r->error, sizeof(r->error), fmt, ap);
+	va_end(ap);
+	return -EINVAL;
+}
+
+/* Makes room for an input of @size bytes with @num_regions regions. */
+static int reserve(struct receiver *r, size_t size, size_t num_regions)
+{
+	void *new_ptr;
+
+	if (size > r->buf_size) {
+		if (r->buf)
+			ASAN_UNPOISON_MEMORY_REGION(r->buf, r->buf_size);
+		free(r->buf);
+		r->buf_size = 0;
+		if (posix_memalign(&new_ptr, RECEIVER_ALIGN, size)) {
+			r->buf = NULL;
+			return -ENOMEM;
+		}
+		r->buf = new_ptr;
+		r->buf_size = size;
+	}
+	if (num_regions > r->alloc_regions) {
+		new_ptr = realloc(r->regions, num_regions * sizeof(struct receiver_region));
+		if (!new_ptr)
+			return -ENOMEM;
+		r->regions = new_ptr;
+		r->alloc_regions = num_regions;
+	}
+	return 0;
+}
+
+int receive_input(struct receiver *r, const char *data, size_t size)
+{
+	size_t relocs_offset, payload_offset, payload_size, end;
+	uint32_t num_regions, num_relocs, padding;
+	uint32_t offset, len, src, dst;
+	const char *entry;
+	char *payload;
+	void *ptr;
+	size_t i;
+	int err;
+
+	r->num_regions = 0;
+	r->error[0] = '\0';
+
+	/* Counts are 32 bits wide, so none of the sizes below can overflow. */
+	if (size < HEADER_SIZE)
+		return reject(r, "input of %zu bytes is shorter than its header", size);
+	if (get_le32(data) != KFUZZTEST_MAGIC)
+		return reject(r, "bad magic 0x%x", get_le32(data));
+	if (get_le32(data + sizeof(uint32_t)) != KFUZZTEST_PROTO_VERSION)
+		return reject(r, "unsupported version %u", get_le32(data + sizeof(uint32_t)));
+
+	num_regions = get_le32(data + 2 * sizeof(uint32_t));
+	relocs_offset = HEADER_SIZE + (size_t)num_regions * REGION_ENTRY_SIZE;
+	if (relocs_offset + RELOC_HEADER_SIZE > size)
+		return reject(r, "region array of %u entries overruns the input of %zu bytes", num_regions, size);
+
+	num_relocs = get_le32(data + relocs_offset);
+	padding = get_le32(data + relocs_offset + sizeof(uint32_t));
+	payload_offset = relocs_offset + RELOC_HEADER_SIZE + (size_t)num_relocs * RELOC_ENTRY_SIZE + padding;
+	if (payload_offset > size)
+		return reject(r, "relocation table of %u entries and %u bytes of padding overruns the input of %zu bytes",
+			      num_relocs, padding, size);
+	payload_size = size - payload_offset;
+
+	if ((err = reserve(r, size, num_regions)))
+		return err;
+	/* The copy keeps the payload at the same alignment as in the encoder's buffer. */
+	ASAN_UNPOISON_MEMORY_REGION(r->buf, r->buf_size);
+	memcpy(r->buf, data, size);
+	payload = r->buf + payload_offset;
+
+	/* Regions come in order, each followed by poison that the next one must not overlap. */
+	end = 0;
+	for (i = 0; i < num_regions; i++) {
+		entry = data + HEADER_SIZE + i * REGION_ENTRY_SIZE;
+		offset = get_le32(entry);
+		len = get_le32(entry + sizeof(uint32_t));
+		if (offset < end)
+			return reject(r, "region %zu at offset %u overlaps the previous region or its poison", i, offset);
+		end = (size_t)offset + len + KFUZZTEST_POISON_SIZE;
+		if (end > payload_size)
+			return reject(r, "region %zu (offset %u, size %u) and its poison overrun the payload of %zu bytes", i,
+				      offset, len, payload_size);
+		r->regions[i] = (struct receiver_region){ .data = payload + offset, .size = len };
+	}
+
+	for (i = 0; i < num_relocs; i++) {
+		entry = data + relocs_offset + RELOC_HEADER_SIZE + i * RELOC_ENTRY_SIZE;
+		src = get_le32(entry);
+		offset = get_le32(entry + sizeof(uint32_t));
+		dst = get_le32(entry + 2 * sizeof(uint32_t));
+		if (src >= num_regions || dst >= num_regions)
+			return reject(r, "relocation %zu links region %u to region %u, out of %u regions", i, src, dst,
+				      num_regions);
+		if ((size_t)offset + sizeof(void *) > r->regions[src].size)
+			return reject(r, "relocation %zu at offset %u overruns region %u of %zu bytes", i, offset, src,
+				      r->regions[src].size);
+		ptr = r->regions[dst].data;
+		memcpy(r->regions[src].data + offset, &ptr, sizeof(ptr));
+	}
+
+	/* Only the regions may be touched, as KASAN enforces in the kernel. */
+	ASAN_POISON_MEMORY_REGION(r->buf, r->buf_size);
+	for (i = 0; i < num_regions; i++)
+		ASAN_UNPOISON_MEMORY_REGION(r->regions[i].data, r->regions[i].size);
+	r->num_regions = num_regions;
+	return 0;
+}
+
+int load_harness(const char *path, struct harness **ret)
+{
+	struct harness *h;
+
+	h = malloc(sizeof(*h));
+	if (!h)
+		return -ENOMEM;
+	h->handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+	if (!h->handle) {
+		printf("failed to load harness: %s\n", dlerror());
+		free(h);
+		return -ENOENT;
+	}
+	h->fn = (kfuzztest_harness_fn)dlsym(h->handle, HARNESS_SYMBOL);
+	if (!h->fn) {
+		printf("failed to load harness %s: no %s function\n", path, HARNESS_SYMBOL);
+		unload_harness(h);
+		return -ENOENT;
+	}
+	*ret = h;
+	return 0;
+}
+
+void unload_harness(struct harness *h)
+{
+	dlclose(h->handle);
+	free(h);
+}
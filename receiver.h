@@ -0,0 +1,118 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Userspace reference receiver for KFuzzTest binary inputs
+ *
+ * Copyright 2025 Google LLC
+ */
+#ifndef RECEIVER_H
+#define RECEIVER_H 1
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Longest diagnostic kept for a rejected input. */
+#define RECEIVER_ERROR_SIZE 160
+
+/* Symbol that a harness shared object exports, see kfuzztest_harness_fn. */
+#define HARNESS_SYMBOL "kfuzztest_harness"
+
+/**
+ * kfuzztest_harness_fn - the signature of an in-process harness
+ *
+ * @arg: the data of the input's first region, which holds the fuzz target's
+ *	argument. Its pointers have been relocated to the regions they point to.
+ * @len: the size of the first region.
+ *
+ * @return 0 on success or a negative errno, which is counted as a failed
+ * injection, as if the kernel's harness had returned it.
+ */
+typedef int (*kfuzztest_harness_fn)(void *arg, size_t len);
+
+struct receiver_region {
+	char *data;
+	size_t size;
+};
+
+/**
+ * struct receiver - decodes inputs the way the KFuzzTest kernel side does
+ *
+ * @buf: the last input, copied so that its payload keeps the alignment that
+ *	the encoder gave it, and relocated in place.
+ * @buf_size: the capacity of @buf.
+ * @regions: the regions of the last input, pointing into @buf.
+ * @num_regions: the number of @regions.
+ * @alloc_regions: the capacity of @regions.
+ * @error: why the last input was rejected, if it was.
+ *
+ * A receiver is reused from one input to the next, and only allocates when an
+ * input is larger, or has more regions, than every one before. It is not
+ * shared between threads.
+ *
+ * When built with AddressSanitizer, every byte of @buf outside the regions of
+ * the last input is poisoned, as KASAN poisons them in the kernel, so that a
+ * harness reading past a region is caught in-process.
+ */
+struct receiver {
+	char *buf;
+	size_t buf_size;
+	struct receiver_region *regions;
+	size_t num_regions;
+	size_t alloc_regions;
+	char error[RECEIVER_ERROR_SIZE];
+};
+
+struct receiver *new_receiver(void);
+
+void destroy_receiver(struct receiver *r);
+
+/**
+ * receive_input - decode, validate and relocate one input
+ *
+ * @r: the receiver.
+ * @data: the input, in the KFuzzTest binary format.
+ * @size: the size of @data.
+ *
+ * Checks the magic and version, that the region array and relocation table fit
+ * the input, that every region fits the payload, in order and followed by
+ * its poison, and that every pointer lies within its region and points to an
+ * existing region. Each pointer is then patched to the address of the region
+ * it points to, so that @r->regions hold a real object graph.
+ *
+ * @return 0 on success, -EINVAL if the input is malformed, in which case the
+ * reason is left in @r->error, or -ENOMEM.
+ */
+int receive_input(struct receiver *r, const char *data, size_t size);
+
+/**
+ * struct harness - a harness function loaded from a shared object
+ *
+ * @handle: the shared object, as returned by dlopen().
+ * @fn: its HARNESS_SYMBOL function.
+ */
+struct harness {
+	void *handle;
+	kfuzztest_harness_fn fn;
+};
+
+/**
+ * load_harness - load a harness from a shared object
+ *
+ * @path: the shared object.
+ * @ret: return pointer for the harness.
+ *
+ * @return 0 on success or a negative errno on failure, which is reported on
+ * stdout.
+ */
+int load_harness(const char *path, struct harness **ret);
+
+void unload_harness(struct harness *h);
+
+/* Runs @h on the last input received by @r. */
+static inline int harness_run(const struct harness *h, struct receiver *r)
+{
+	if (!r->num_regions)
+		return h->fn(NULL, 0);
+	return h->fn(r->regions[0].data, r->regions[0].size);
+}
+
+#endif /* RECEIVER_H */
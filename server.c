@@ -0,0 +1,406 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Long-lived server encoding and injecting inputs on behalf of an executor
+ *
+ * Copyright 2025 Google LLC
+ */
+#include <asm-generic/errno-base.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "arena.h"
+#include "kfuzztest_encoder.h"
+#include "kfuzztest_input_parser.h"
+#include "rand_stream.h"
+#include "server.h"
+#include "timing.h"
+
+#define SERVER_BACKLOG 16
+
+/* Longest target name accepted in a SERVER_REQ_INJECT request. */
+#define SERVER_MAX_TARGET_NAME 256
+
+/* Initial size of a connection's request buffer, enough for most requests. */
+#define SERVER_CONN_BUFFER_SIZE 4096
+
+/* Replies a connection may have pending before its requests are left unread. */
+#define SERVER_MAX_PENDING_REPLIES 64
+
+/**
+ * struct server_schema - a registered schema
+ *
+ * @text: the schema's textual description.
+ * @tmpl: the schema's layout.
+ * @arena: holds @tmpl and the AST it was compiled from.
+ *
+ * Each schema has an arena of its own, so that a schema that fails to compile
+ * leaves nothing behind, however many a client sends.
+ */
+struct server_schema {
+	char *text;
+	struct encode_template *tmpl;
+	struct arena *arena;
+};
+
+/**
+ * struct server_conn - the state of a connection between poll() rounds
+ *
+ * @in: bytes received but not served yet, holding at most one partial request
+ *	at its end.
+ * @in_len: the number of bytes in @in.
+ * @in_size: the capacity of @in, which grows to fit the largest request.
+ * @out: replies not sent yet, because the client has not read earlier ones.
+ * @out_len: the number of bytes in @out.
+ *
+ * Connections are non-blocking, so that a client sending a request slowly, or
+ * not reading its replies, never holds up the others.
+ */
+struct server_conn {
+	char *in;
+	size_t in_len;
+	size_t in_size;
+	char out[SERVER_MAX_PENDING_REPLIES * sizeof(struct server_reply)];
+	size_t out_len;
+};
+
+struct server {
+	struct target_registry *reg;
+	struct sink *sink;
+	const volatile sig_atomic_t *stop;
+
+	struct server_schema *schemas;
+	size_t num_schemas;
+
+	/* Holds the input being encoded, and is reset for every request. */
+	struct arena *input_arena;
+
+	/*
+	 * fds[0] is the listening socket, the rest are connections, whose
+	 * state is in the matching entries of conns.
+	 */
+	struct pollfd *fds;
+	struct server_conn *conns;
+	size_t num_fds;
+};
+
+/* Sends as many pending replies as the socket takes without blocking. */
+static int flush_replies(struct server_conn *c, int fd)
+{
+	ssize_t ret;
+
+	while (c->out_len) {
+		/* A client hanging up must not kill the server with SIGPIPE. */
+		ret = send(fd, c->out, c->out_len, MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return 0;
+		if (ret < 0)
+			return -errno;
+		memmove(c->out, c->out + ret, c->out_len - ret);
+		c->out_len -= ret;
+	}
+	return 0;
+}
+
+/* Receives what the socket holds, without blocking, up to the end of the next request. */
+static int read_requests(struct server_conn *c, int fd)
+{
+	struct server_req req;
+	size_t needed = sizeof(req);
+	void *new_ptr;
+	ssize_t ret;
+
+	if (c->in_len >= sizeof(req)) {
+		memcpy(&req, c->in, sizeof(req));
+		/* The stream cannot be resynchronized after an oversized request. */
+		if (req.len > SERVER_MAX_PAYLOAD)
+			return -EMSGSIZE;
+		needed += req.len;
+	}
+	if (needed < SERVER_CONN_BUFFER_SIZE)
+		needed = SERVER_CONN_BUFFER_SIZE;
+	if (needed > c->in_size) {
+		new_ptr = realloc(c->in, needed);
+		if (!new_ptr)
+			return -ENOMEM;
+		c->in = new_ptr;
+		c->in_size = needed;
+	}
+
+	ret = recv(fd, c->in + c->in_len, c->in_size - c->in_len, MSG_DONTWAIT);
+	if (ret < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK))
+		return 0;
+	if (ret < 0)
+		return -errno;
+	if (ret == 0)
+		return -ECONNRESET;
+	c->in_len += ret;
+	return 0;
+}
+
+static int handle_register(struct server *srv, const char *payload, size_t len, struct server_reply *reply)
+{
+	struct server_schema *schema;
+	struct ast_node *ast;
+	void *new_ptr;
+	size_t i;
+	int err;
+
+	/* Executors tend to register the same schema on every connection. */
+	for (i = 0; i < srv->num_schemas; i++) {
+		if (strlen(srv->schemas[i].text) == len && memcmp(srv->schemas[i].text, payload, len) == 0) {
+			reply->schema_id = i;
+			return 0;
+		}
+	}
+
+	new_ptr = realloc(srv->schemas, (srv->num_schemas + 1) * sizeof(struct server_schema));
+	if (!new_ptr)
+		return -ENOMEM;
+	srv->schemas = new_ptr;
+
+	schema = &srv->schemas[srv->num_schemas];
+	schema->text = strndup(payload, len);
+	schema->arena = new_arena(SCHEMA_ARENA_CHUNK_SIZE);
+	err = schema->text && schema->arena ? 0 : -ENOMEM;
+	if (!err)
+		err = compile_schema(schema->text, schema->arena, &ast);
+	if (!err)
+		err = compile_template(ast, schema->arena, &schema->tmpl);
+	if (err) {
+		free(schema->text);
+		if (schema->arena)
+			destroy_arena(schema->arena);
+		return err;
+	}
+
+	reply->schema_id = srv->num_schemas++;
+	return 0;
+}
+
+static int handle_inject(struct server *srv, const char *payload, size_t len, struct server_reply *reply)
+{
+	char target_name[SERVER_MAX_TARGET_NAME];
+	struct kfuzztest_target *target = NULL;
+	struct server_inject req;
+	struct rand_stream rs;
+	char *input;
+	size_t num_bytes;
+	uint64_t start;
+	int err;
+
+	if (len < sizeof(req))
+		return -EINVAL;
+	memcpy(&req, payload, sizeof(req));
+	payload += sizeof(req);
+	len -= sizeof(req);
+
+	reply->schema_id = req.schema_id;
+	if (req.schema_id >= srv->num_schemas || req.target_len > len)
+		return -EINVAL;
+	if (req.target_len >= sizeof(target_name))
+		return -ENAMETOOLONG;
+	memcpy(target_name, payload, req.target_len);
+	target_name[req.target_len] = '\0';
+	payload += req.target_len;
+	len -= req.target_len;
+
+	if (srv->sink->type == SINK_DEBUGFS && !(target = registry_get(srv->reg, target_name)))
+		return -ENOENT;
+
+	/* The request itself is the byte source; nothing is copied. */
+	init_mem_rand_stream(&rs, payload, len, true);
+	arena_reset(srv->input_arena);
+	err = encode(srv->schemas[req.schema_id].tmpl, &rs, NULL, srv->input_arena, NULL, &num_bytes, &input);
+	if (err)
+		return err;
+
+	start = now_ns();
+	err = sink_write(srv->sink, target, input, num_bytes);
+	reply->latency_ns = now_ns() - start;
+	return err;
+}
+
+/* Serves a single request and queues its reply. */
+static void serve_one(struct server *srv, struct server_conn *c, const struct server_req *req, const char *payload)
+{
+	struct server_reply reply = { 0 };
+
+	switch (req->type) {
+	case SERVER_REQ_REGISTER:
+		reply.status = handle_register(srv, payload, req->len, &reply);
+		break;
+	case SERVER_REQ_INJECT:
+		reply.status = handle_inject(srv, payload, req->len, &reply);
+		break;
+	default:
+		reply.status = -EOPNOTSUPP;
+		break;
+	}
+	memcpy(c->out + c->out_len, &reply, sizeof(reply));
+	c->out_len += sizeof(reply);
+}
+
+/* Serves the complete requests received on a connection, while there is room for their replies. */
+static void serve_requests(struct server *srv, struct server_conn *c)
+{
+	struct server_req req;
+	size_t pos = 0;
+
+	while (c->out_len < sizeof(c->out) && c->in_len - pos >= sizeof(req)) {
+		memcpy(&req, c->in + pos, sizeof(req));
+		/* Oversized requests are rejected when more bytes are read. */
+		if (req.len > SERVER_MAX_PAYLOAD || c->in_len - pos - sizeof(req) < req.len)
+			break;
+		serve_one(srv, c, &req, c->in + pos + sizeof(req));
+		pos += sizeof(req) + req.len;
+	}
+	memmove(c->in, c->in + pos, c->in_len - pos);
+	c->in_len -= pos;
+}
+
+/* Makes progress on a connection. Returns a negative errno if it should be closed. */
+static int serve_conn(struct server *srv, size_t i)
+{
+	struct server_conn *c = &srv->conns[i];
+	struct pollfd *pfd = &srv->fds[i];
+	int err;
+
+	if ((pfd->revents & POLLOUT) && (err = flush_replies(c, pfd->fd)))
+		return err;
+	/* A hangup is only noticed once every request sent before it has been read. */
+	if ((pfd->revents & (POLLIN | POLLHUP | POLLERR)) && c->out_len < sizeof(c->out) &&
+	    (err = read_requests(c, pfd->fd)))
+		return err;
+	serve_requests(srv, c);
+	if ((err = flush_replies(c, pfd->fd)))
+		return err;
+
+	/* Stop reading from a client that does not read its replies. */
+	pfd->events = (c->out_len < sizeof(c->out) ? POLLIN : 0) | (c->out_len ? POLLOUT : 0);
+	return 0;
+}
+
+static int add_fd(struct server *srv, int fd)
+{
+	void *new_ptr;
+
+	new_ptr = realloc(srv->fds, (srv->num_fds + 1) * sizeof(struct pollfd));
+	if (!new_ptr)
+		return -ENOMEM;
+	srv->fds = new_ptr;
+	new_ptr = realloc(srv->conns, (srv->num_fds + 1) * sizeof(struct server_conn));
+	if (!new_ptr)
+		return -ENOMEM;
+	srv->conns = new_ptr;
+	srv->fds[srv->num_fds] = (struct pollfd){ .fd = fd, .events = POLLIN };
+	srv->conns[srv->num_fds] = (struct server_conn){ 0 };
+	srv->num_fds++;
+	return 0;
+}
+
+/* Closes a connection, moving the last one into its place. */
+static void drop_fd(struct server *srv, size_t i)
+{
+	close(srv->fds[i].fd);
+	free(srv->conns[i].in);
+	srv->num_fds--;
+	srv->fds[i] = srv->fds[srv->num_fds];
+	srv->conns[i] = srv->conns[srv->num_fds];
+}
+
+static int listen_on(const char *path)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	struct stat st;
+	int fd;
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+		return -ENAMETOOLONG;
+	strcpy(addr.sun_path, path);
+
+	/* Replace the socket left behind by a previous instance, but nothing else. */
+	if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+		unlink(path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -errno;
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) || listen(fd, SERVER_BACKLOG)) {
+		close(fd);
+		return -errno;
+	}
+	return fd;
+}
+
+int run_server(const char *path, struct target_registry *reg, struct sink *sink, const volatile sig_atomic_t *stop)
+{
+	struct server srv = { .reg = reg, .sink = sink, .stop = stop };
+	size_t num_fds;
+	size_t i;
+	int err;
+	int fd;
+
+	fd = listen_on(path);
+	if (fd < 0)
+		return fd;
+	srv.input_arena = new_arena(ENCODE_ARENA_CHUNK_SIZE);
+	if (!srv.input_arena) {
+		close(fd);
+		err = -ENOMEM;
+		goto out;
+	}
+	if ((err = add_fd(&srv, fd))) {
+		close(fd);
+		goto out;
+	}
+	printf("listening on %s\n", path);
+	fflush(stdout);
+
+	while (!*stop) {
+		if (poll(srv.fds, srv.num_fds, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			err = -errno;
+			break;
+		}
+
+		/* Connections accepted in this round are only polled in the next. */
+		num_fds = srv.num_fds;
+		if (srv.fds[0].revents & POLLIN) {
+			fd = accept4(srv.fds[0].fd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+			if (fd >= 0 && add_fd(&srv, fd))
+				close(fd);
+		}
+
+		for (i = num_fds; i-- > 1;) {
+			if (srv.fds[i].revents && serve_conn(&srv, i))
+				drop_fd(&srv, i);
+		}
+	}
+
+out:
+	while (srv.num_fds > 1)
+		drop_fd(&srv, srv.num_fds - 1);
+	if (srv.num_fds)
+		close(srv.fds[0].fd);
+	unlink(path);
+	free(srv.fds);
+	free(srv.conns);
+	for (i = 0; i < srv.num_schemas; i++) {
+		free(srv.schemas[i].text);
+		destroy_arena(srv.schemas[i].arena);
+	}
+	free(srv.schemas);
+	if (srv.input_arena)
+		destroy_arena(srv.input_arena);
+	return err;
+}
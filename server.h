@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Long-lived server encoding and injecting inputs on behalf of an executor
+ *
+ * Copyright 2025 Google LLC
+ */
+#ifndef SERVER_H
+#define SERVER_H 1
+
+#include <signal.h>
+#include <stdint.h>
+
+#include "sink.h"
+#include "target_registry.h"
+
+/* Largest request payload accepted, in bytes. */
+#define SERVER_MAX_PAYLOAD (16 << 20)
+
+enum server_req_type {
+	/* Payload: the schema's textual description. */
+	SERVER_REQ_REGISTER = 1,
+	/* Payload: a struct server_inject, the target name, then the raw bytes. */
+	SERVER_REQ_INJECT = 2,
+};
+
+/**
+ * struct server_req - header preceding every request
+ *
+ * @type: an enum server_req_type.
+ * @len: number of payload bytes following the header.
+ *
+ * All integers on the wire are in host byte order.
+ */
+struct server_req {
+	uint32_t type;
+	uint32_t len;
+};
+
+/**
+ * struct server_inject - start of a SERVER_REQ_INJECT payload
+ *
+ * @schema_id: an id returned by SERVER_REQ_REGISTER.
+ * @target_len: length of the target name that follows, without a NUL.
+ *
+ * Every remaining payload byte is used as the input's byte source. If the
+ * schema needs more bytes than are given, the rest are zero.
+ */
+struct server_inject {
+	uint32_t schema_id;
+	uint32_t target_len;
+};
+
+/**
+ * struct server_reply - sent in response to every request
+ *
+ * @status: 0 on success or a negative errno. For SERVER_REQ_INJECT, this is
+ *	the result of encoding the input or, if that succeeded, of writing it.
+ * @schema_id: the registered schema's id, or the one the input was encoded
+ *	with.
+ * @latency_ns: time taken by the write, or 0 if nothing was written.
+ */
+struct server_reply {
+	int32_t status;
+	uint32_t schema_id;
+	uint64_t latency_ns;
+};
+
+/**
+ * run_server - serve requests on a Unix domain socket until asked to stop
+ *
+ * @path: filesystem path at which to listen. A stale socket at @path is
+ *	replaced, and the socket is removed on return.
+ * @reg: registry used to resolve target names if @sink writes to debugfs.
+ * @sink: where encoded inputs are delivered.
+ * @stop: set asynchronously to ask the server to stop.
+ *
+ * Schemas are compiled once when they are registered and shared by every
+ * connection. Requests are served one at a time, in the order they are
+ * completely received, so that no connection can stall the others.
+ *
+ * @return 0 on success or a negative errno on failure.
+ */
+int run_server(const char *path, struct target_registry *reg, struct sink *sink, const volatile sig_atomic_t *stop);
+
+#endif /* SERVER_H */
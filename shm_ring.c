@@ -0,0 +1,132 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Shared-memory ring through which an external fuzzer hands inputs to the
+ * bridge without copying them
+ *
+ * Copyright 2025 Google LLC
+ */
+#include <asm-generic/errno-base.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "shm_ring.h"
+#include "timing.h"
+
+/* Polls of an empty ring before yielding the CPU, and before sleeping. */
+#define SHM_RING_SPINS 128
+#define SHM_RING_YIELDS 1024
+#define SHM_RING_SLEEP_NS 50000
+
+static struct shm_ring_slot *slot_at(struct shm_ring *ring, uint64_t seq)
+{
+	return (struct shm_ring_slot *)((char *)ring->hdr + sizeof(*ring->hdr) +
+					(seq & ring->mask) * ring->stride);
+}
+
+struct shm_ring *open_shm_ring(const char *path)
+{
+	struct shm_ring_hdr hdr;
+	struct shm_ring *ring;
+	struct stat st;
+	size_t size;
+	void *map;
+	int fd;
+
+	fd = open(path, O_RDWR | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, &st) || st.st_size < sizeof(hdr) || pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr))
+		goto fail;
+
+	if (hdr.magic != SHM_RING_MAGIC || hdr.version != SHM_RING_VERSION || !hdr.slot_size || !hdr.num_slots ||
+	    (hdr.num_slots & (hdr.num_slots - 1)))
+		goto fail;
+	size = sizeof(hdr) + (size_t)hdr.num_slots * shm_ring_stride(hdr.slot_size);
+	if (st.st_size < size)
+		goto fail;
+
+	map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+	if (map == MAP_FAILED)
+		goto fail;
+	close(fd);
+
+	ring = calloc(1, sizeof(*ring));
+	if (!ring) {
+		munmap(map, size);
+		return NULL;
+	}
+	ring->hdr = map;
+	ring->map_size = size;
+	ring->stride = shm_ring_stride(hdr.slot_size);
+	ring->mask = hdr.num_slots - 1;
+	ring->slot_size = hdr.slot_size;
+	ring->tail = __atomic_load_n(&ring->hdr->tail, __ATOMIC_ACQUIRE);
+	ring->cached_head = ring->tail;
+	return ring;
+
+fail:
+	close(fd);
+	return NULL;
+}
+
+void close_shm_ring(struct shm_ring *ring)
+{
+	munmap(ring->hdr, ring->map_size);
+	free(ring);
+}
+
+/*
+ * The producer needs no syscalls to hand over an input, so an idle ring is
+ * polled: busily at first, to keep the handoff latency low while inputs are
+ * flowing, then backing off so that an idle bridge does not burn a CPU.
+ */
+static void backoff(unsigned int *polls)
+{
+	struct timespec ts = { .tv_sec = 0, .tv_nsec = SHM_RING_SLEEP_NS };
+
+	if (++*polls < SHM_RING_SPINS)
+		return;
+	if (*polls < SHM_RING_YIELDS)
+		sched_yield();
+	else
+		nanosleep(&ts, NULL);
+}
+
+int shm_ring_next(struct shm_ring *ring, const volatile sig_atomic_t *stop, uint64_t deadline,
+		  struct rand_stream *rs)
+{
+	struct shm_ring_slot *slot;
+	unsigned int polls = 0;
+	uint32_t len;
+
+	while (ring->tail == ring->cached_head) {
+		ring->cached_head = __atomic_load_n(&ring->hdr->head, __ATOMIC_ACQUIRE);
+		if (ring->tail != ring->cached_head)
+			break;
+		if (*stop || (deadline && now_ns() >= deadline))
+			return -ENODATA;
+		backoff(&polls);
+	}
+
+	slot = slot_at(ring, ring->tail);
+	/* The length comes from another process; never read past the slot. */
+	len = slot->len;
+	if (len > ring->slot_size)
+		len = ring->slot_size;
+	init_mem_rand_stream(rs, slot->data, len, true);
+	return 0;
+}
+
+void shm_ring_complete(struct shm_ring *ring, int result, uint64_t latency_ns)
+{
+	struct shm_ring_slot *slot = slot_at(ring, ring->tail);
+
+	slot->result = result;
+	slot->latency_ns = latency_ns;
+	__atomic_store_n(&ring->hdr->tail, ++ring->tail, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,127 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Shared-memory ring through which an external fuzzer hands inputs to the
+ * bridge without copying them
+ *
+ * Copyright 2025 Google LLC
+ */
+#ifndef SHM_RING_H
+#define SHM_RING_H 1
+
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "rand_stream.h"
+
+#define SHM_RING_MAGIC 0x4b465452 /* "KFTR" */
+#define SHM_RING_VERSION 1
+
+/**
+ * struct shm_ring_hdr - header at offset 0 of the shared memory
+ *
+ * @magic: SHM_RING_MAGIC.
+ * @version: SHM_RING_VERSION.
+ * @num_slots: number of slots, a power of two.
+ * @slot_size: capacity of each slot's data, in bytes.
+ * @head: number of slots ever filled. Only written by the producer.
+ * @tail: number of slots ever consumed. Only written by the bridge.
+ *
+ * The header is followed by @num_slots slots, each a struct shm_ring_slot
+ * padded to a multiple of 64 bytes, see shm_ring_stride(). Slot i holds the
+ * input with sequence number n whenever n % @num_slots == i.
+ *
+ * To hand over an input, the producer waits until @head - @tail < @num_slots,
+ * fills in the slot's @len and @data, and increments @head with release
+ * semantics. Once @tail has passed the slot, its @result and @latency_ns hold
+ * the outcome, until the producer reuses the slot.
+ */
+struct shm_ring_hdr {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t num_slots;
+	uint32_t slot_size;
+	uint64_t head __attribute__((aligned(64)));
+	uint64_t tail __attribute__((aligned(64)));
+} __attribute__((aligned(64)));
+
+/**
+ * struct shm_ring_slot - one input and its outcome
+ *
+ * @len: number of valid bytes in @data, set by the producer. If the schema
+ *	needs more bytes, the rest are read as zero.
+ * @result: 0 on success or a negative errno, set by the bridge, as for the
+ *	result of encoding the input or, if that succeeded, of writing it.
+ * @latency_ns: duration of the write, set by the bridge.
+ * @data: the raw bytes from which the input is encoded.
+ */
+struct shm_ring_slot {
+	uint32_t len;
+	int32_t result;
+	uint64_t latency_ns;
+	char data[];
+};
+
+static inline size_t shm_ring_stride(uint32_t slot_size)
+{
+	return (sizeof(struct shm_ring_slot) + slot_size + 63) & ~(size_t)63;
+}
+
+/**
+ * struct shm_ring - the bridge's end of a ring
+ *
+ * @hdr: the shared header, followed by the slots.
+ * @map_size: size of the mapping starting at @hdr.
+ * @stride: distance between consecutive slots.
+ * @mask, @slot_size: private copies of the ring's geometry, which the
+ *	producer could otherwise change underneath the bridge.
+ * @tail: private copy of @hdr->tail.
+ * @cached_head: last value read from @hdr->head, so that the shared line is
+ *	only read when the bridge has caught up with the producer.
+ */
+struct shm_ring {
+	struct shm_ring_hdr *hdr;
+	size_t map_size;
+	size_t stride;
+	uint32_t mask;
+	uint32_t slot_size;
+	uint64_t tail;
+	uint64_t cached_head;
+};
+
+/**
+ * open_shm_ring - map a ring set up by the producer
+ *
+ * @path: a file holding the ring, e.g., under /dev/shm, or /proc/<pid>/fd/<n>
+ *	for a memfd.
+ *
+ * Inputs that the producer queued before the bridge attached are consumed.
+ *
+ * @return the ring, or NULL if @path does not hold a valid ring.
+ */
+struct shm_ring *open_shm_ring(const char *path);
+
+void close_shm_ring(struct shm_ring *ring);
+
+/**
+ * shm_ring_next - wait for the next input
+ *
+ * @ring: an open ring.
+ * @stop: set asynchronously to stop waiting.
+ * @deadline: CLOCK_MONOTONIC time in ns at which to stop waiting, or 0.
+ * @rs: initialized to read the input's bytes in place.
+ *
+ * The slot is owned by the bridge until shm_ring_complete() is called.
+ *
+ * @return 0 on success or -ENODATA if waiting was stopped.
+ */
+int shm_ring_next(struct shm_ring *ring, const volatile sig_atomic_t *stop, uint64_t deadline,
+		  struct rand_stream *rs);
+
+/**
+ * shm_ring_complete - report the outcome of the current input and release
+ * its slot back to the producer
+ */
+void shm_ring_complete(struct shm_ring *ring, int result, uint64_t latency_ns);
+
+#endif /* SHM_RING_H */
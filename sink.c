@@ -0,0 +1,172 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Destinations for encoded KFuzzTest inputs
+ *
+ * Copyright 2025 Google LLC
+ */
+#include <asm-generic/errno-base.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sink.h"
+
+/* Large enough that appending an input rarely costs a write(). */
+#define SINK_FILE_BUFFER_SIZE (1 << 20)
+
+/*
+ * Moves stdout to a private stream for the sink, and points file descriptor 1
+ * at stderr so that the bridge's messages cannot corrupt the blob stream.
+ */
+static FILE *take_stdout(void)
+{
+	FILE *f;
+	int fd;
+
+	fflush(stdout);
+	fd = dup(STDOUT_FILENO);
+	if (fd < 0)
+		return NULL;
+	f = fdopen(fd, "wb");
+	if (!f) {
+		close(fd);
+		return NULL;
+	}
+	if (dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+		fclose(f);
+		return NULL;
+	}
+	return f;
+}
+
+static void free_receiver(void *r)
+{
+	destroy_receiver(r);
+}
+
+static struct sink *new_receiver_sink(struct sink *s, const char *path)
+{
+	if (path && load_harness(path, &s->harness)) {
+		free(s);
+		return NULL;
+	}
+	if (pthread_key_create(&s->receiver_key, free_receiver)) {
+		if (s->harness)
+			unload_harness(s->harness);
+		free(s);
+		return NULL;
+	}
+	return s;
+}
+
+struct sink *new_sink(enum sink_type type, const char *path)
+{
+	struct sink *s;
+
+	s = calloc(1, sizeof(*s));
+	if (!s)
+		return NULL;
+	s->type = type;
+	if (type == SINK_RECEIVER)
+		return new_receiver_sink(s, path);
+	if (type != SINK_FILE)
+		return s;
+
+	s->file = strcmp(path, "-") == 0 ? take_stdout() : fopen(path, "wb");
+	if (!s->file) {
+		free(s);
+		return NULL;
+	}
+	/* glibc ignores the size unless it is also given the buffer. */
+	s->file_buffer = malloc(SINK_FILE_BUFFER_SIZE);
+	if (s->file_buffer)
+		setvbuf(s->file, s->file_buffer, _IOFBF, SINK_FILE_BUFFER_SIZE);
+	pthread_mutex_init(&s->lock, NULL);
+	return s;
+}
+
+int destroy_sink(struct sink *s)
+{
+	struct receiver *r;
+	int err = 0;
+
+	if (s->type == SINK_RECEIVER) {
+		/* Workers' receivers went with their threads; only the caller's is left. */
+		r = pthread_getspecific(s->receiver_key);
+		if (r)
+			destroy_receiver(r);
+		pthread_key_delete(s->receiver_key);
+		if (s->harness)
+			unload_harness(s->harness);
+	}
+
+	if (s->file) {
+		if (fclose(s->file))
+			err = -errno;
+		free(s->file_buffer);
+		pthread_mutex_destroy(&s->lock);
+	}
+	free(s);
+	return err;
+}
+
+static int file_write(struct sink *s, const char *data, size_t data_size)
+{
+	unsigned char len[4];
+	int err = 0;
+
+	if (data_size > UINT32_MAX)
+		return -EFBIG;
+	len[0] = data_size;
+	len[1] = data_size >> 8;
+	len[2] = data_size >> 16;
+	len[3] = data_size >> 24;
+
+	pthread_mutex_lock(&s->lock);
+	errno = 0;
+	if (fwrite(len, sizeof(len), 1, s->file) != 1 || fwrite(data, 1, data_size, s->file) != data_size)
+		err = errno ? -errno : -EIO;
+	pthread_mutex_unlock(&s->lock);
+	return err;
+}
+
+static int receiver_write(struct sink *s, const char *data, size_t data_size)
+{
+	struct receiver *r;
+	int err;
+
+	r = pthread_getspecific(s->receiver_key);
+	if (!r) {
+		r = new_receiver();
+		if (!r)
+			return -ENOMEM;
+		if (pthread_setspecific(s->receiver_key, r)) {
+			destroy_receiver(r);
+			return -ENOMEM;
+		}
+	}
+
+	err = receive_input(r, data, data_size);
+	/* Malformed inputs usually come from a systematic encoder bug, so one report is enough. */
+	if (err == -EINVAL && !__atomic_exchange_n(&s->reported, true, __ATOMIC_RELAXED))
+		printf("receiver rejected an input: %s\n", r->error);
+	if (err)
+		return err;
+	return s->harness ? harness_run(s->harness, r) : 0;
+}
+
+int sink_write(struct sink *s, struct kfuzztest_target *t, const char *data, size_t data_size)
+{
+	switch (s->type) {
+	case SINK_DEBUGFS:
+		return target_write(t, data, data_size);
+	case SINK_FILE:
+		return file_write(s, data, data_size);
+	case SINK_RECEIVER:
+		return receiver_write(s, data, data_size);
+	case SINK_NULL:
+	default:
+		return 0;
+	}
+}
@@ -0,0 +1,84 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Destinations for encoded KFuzzTest inputs
+ *
+ * Copyright 2025 Google LLC
+ */
+#ifndef SINK_H
+#define SINK_H 1
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "receiver.h"
+#include "target_registry.h"
+
+enum sink_type {
+	SINK_DEBUGFS,
+	SINK_FILE,
+	SINK_NULL,
+	SINK_RECEIVER,
+};
+
+/**
+ * struct sink - where encoded inputs end up
+ *
+ * @type: the kind of sink.
+ * @file: for SINK_FILE, the stream that blobs are appended to.
+ * @file_buffer: the stdio buffer of @file.
+ * @lock: serializes workers appending to @file.
+ * @harness: for SINK_RECEIVER, the harness run on each input, or NULL.
+ * @receiver_key: for SINK_RECEIVER, each thread's own receiver.
+ * @reported: whether a SINK_RECEIVER sink has reported a rejected input.
+ *
+ * A SINK_DEBUGFS sink writes each input to the caller's target, while the
+ * other sinks need no kernel at all, so that the encoder can be benchmarked
+ * and its output compared across versions on any machine. A SINK_FILE sink
+ * writes every input as a little-endian u32 length followed by that many
+ * bytes. A SINK_RECEIVER sink decodes every input in-process, as the kernel
+ * would, so that a malformed input fails like a rejected write.
+ */
+struct sink {
+	enum sink_type type;
+	FILE *file;
+	char *file_buffer;
+	pthread_mutex_t lock;
+	struct harness *harness;
+	pthread_key_t receiver_key;
+	bool reported;
+};
+
+/**
+ * new_sink - create a sink
+ *
+ * @type: the kind of sink.
+ * @path: for SINK_FILE, the output file, or "-" for stdout. Since stdout then
+ *	carries binary data, the bridge's own messages are sent to stderr. For
+ *	SINK_RECEIVER, the shared object to load a harness from, or NULL.
+ *
+ * @return the new sink, or NULL on failure.
+ */
+struct sink *new_sink(enum sink_type type, const char *path);
+
+/**
+ * destroy_sink - flush any buffered output and release the sink
+ *
+ * @return 0 on success or a negative errno if buffered output was lost.
+ */
+int destroy_sink(struct sink *s);
+
+/**
+ * sink_write - deliver one encoded input
+ *
+ * @s: the sink.
+ * @t: the target to write to, only used by SINK_DEBUGFS.
+ * @data: the encoded input.
+ * @data_size: the size of @data in bytes.
+ *
+ * @return 0 on success or a negative errno on failure.
+ */
+int sink_write(struct sink *s, struct kfuzztest_target *t, const char *data, size_t data_size);
+
+#endif /* SINK_H */
@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Lock-free ring of input buffers between one producer and one consumer
+ *
+ * Copyright 2025 Google LLC
+ */
+#include <asm-generic/errno-base.h>
+#include <errno.h>
+
+#include "handoff.h"
+#include "spsc_ring.h"
+
+struct spsc_ring *new_spsc_ring(size_t buffer_size, unsigned int depth)
+{
+	struct spsc_ring *r;
+
+	if (!depth || posix_memalign((void **)&r, __alignof__(struct spsc_ring), sizeof(*r)))
+		return NULL;
+	*r = (struct spsc_ring){
+		.buffer_size = buffer_size,
+		.depth = depth,
+	};
+
+	r->buffers = malloc(depth * buffer_size);
+	r->lens = calloc(depth, sizeof(size_t));
+	if (!r->buffers || !r->lens) {
+		destroy_spsc_ring(r);
+		return NULL;
+	}
+	return r;
+}
+
+void destroy_spsc_ring(struct spsc_ring *r)
+{
+	free(r->buffers);
+	free(r->lens);
+	free(r);
+}
+
+char *spsc_ring_reserve(struct spsc_ring *r)
+{
+	/* The consumer is at most @depth buffers behind. */
+	wait_for_change(&r->tail, r->head - r->depth, &r->producer_waiting);
+	return r->buffers + (r->head % r->depth) * r->buffer_size;
+}
+
+void spsc_ring_publish(struct spsc_ring *r, size_t len)
+{
+	r->lens[r->head % r->depth] = len;
+	bump(&r->head, &r->consumer_waiting);
+	/* Pairs with the consumer arming the doorbell, then checking @head. */
+	if (r->doorbell && __atomic_load_n(&r->doorbell->waiting, __ATOMIC_SEQ_CST)) {
+		__atomic_add_fetch(&r->doorbell->count, 1, __ATOMIC_SEQ_CST);
+		futex_wake(&r->doorbell->count);
+	}
+}
+
+void spsc_ring_close(struct spsc_ring *r)
+{
+	spsc_ring_reserve(r);
+	spsc_ring_publish(r, SPSC_RING_CLOSED);
+}
+
+int spsc_ring_try_next(struct spsc_ring *r, char **buf, size_t *len)
+{
+	unsigned int i;
+
+	if (__atomic_load_n(&r->head, __ATOMIC_ACQUIRE) == r->tail)
+		return -EAGAIN;
+	i = r->tail % r->depth;
+	/* The closing entry is never released, so every later call ends up here too. */
+	if (r->lens[i] == SPSC_RING_CLOSED)
+		return -ENODATA;
+	*len = r->lens[i];
+	*buf = r->buffers + i * r->buffer_size;
+	return 0;
+}
+
+bool spsc_ring_ready(struct spsc_ring *r)
+{
+	return __atomic_load_n(&r->head, __ATOMIC_SEQ_CST) != r->tail &&
+	       r->lens[r->tail % r->depth] != SPSC_RING_CLOSED;
+}
+
+void spsc_ring_release(struct spsc_ring *r)
+{
+	bump(&r->tail, &r->producer_waiting);
+}
+
+uint32_t spsc_doorbell_arm(struct spsc_doorbell *d)
+{
+	uint32_t seen = __atomic_load_n(&d->count, __ATOMIC_RELAXED);
+
+	__atomic_store_n(&d->waiting, 1, __ATOMIC_SEQ_CST);
+	return seen;
+}
+
+void spsc_doorbell_wait(struct spsc_doorbell *d, uint32_t seen)
+{
+	futex_wait(&d->count, seen);
+	spsc_doorbell_disarm(d);
+}
+
+void spsc_doorbell_disarm(struct spsc_doorbell *d)
+{
+	__atomic_store_n(&d->waiting, 0, __ATOMIC_RELAXED);
+}
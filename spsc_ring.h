@@ -0,0 +1,133 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Lock-free ring of input buffers between one producer and one consumer
+ *
+ * Copyright 2025 Google LLC
+ */
+#ifndef SPSC_RING_H
+#define SPSC_RING_H 1
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Length published by spsc_ring_close() to mark the end of the ring. */
+#define SPSC_RING_CLOSED SIZE_MAX
+
+/**
+ * struct spsc_doorbell - a wakeup shared by the producers of several rings
+ *
+ * @count: bumped by a producer after publishing, if the consumer is waiting.
+ * @waiting: set by the consumer before it sleeps on @count.
+ *
+ * A consumer draining several rings cannot sleep on any one of them without
+ * missing the others. Instead, it polls every ring, and only once they are all
+ * empty, arms the doorbell, checks the rings a last time and sleeps on @count.
+ * Producers only touch the doorbell while the consumer is armed, so it costs
+ * nothing while the consumer keeps up.
+ */
+struct spsc_doorbell {
+	uint32_t count __attribute__((aligned(64)));
+	uint32_t waiting;
+};
+
+/**
+ * struct spsc_ring - a pool of buffers handed from a producer to a consumer
+ *
+ * @buffers: @depth buffers of @buffer_size bytes, allocated in one piece.
+ * @buffer_size: the size of each buffer.
+ * @depth: the number of buffers.
+ * @lens: the number of bytes published in each buffer.
+ * @head: number of buffers published, written by the producer.
+ * @tail: number of buffers released, written by the consumer.
+ * @producer_waiting, @consumer_waiting: set by either side before it sleeps
+ *	on the other's counter, so that the other side only makes a syscall to
+ *	wake it when it has to.
+ * @doorbell: if set, rung on every publication, for a consumer of several
+ *	rings.
+ *
+ * Buffers go round the ring forever: the producer fills the buffer at @head
+ * and publishes it, and the consumer uses the buffer at @tail and releases it
+ * back to the producer. Neither side allocates, copies or takes a lock, and
+ * the producer waits once every buffer is in flight, so a slow consumer holds
+ * back its producer.
+ */
+struct spsc_ring {
+	char *buffers;
+	size_t buffer_size;
+	unsigned int depth;
+	size_t *lens;
+	struct spsc_doorbell *doorbell;
+
+	uint32_t head __attribute__((aligned(64)));
+	uint32_t consumer_waiting;
+
+	uint32_t tail __attribute__((aligned(64)));
+	uint32_t producer_waiting;
+};
+
+/**
+ * new_spsc_ring - allocate a ring and its buffers
+ *
+ * @buffer_size: the size of each buffer.
+ * @depth: the number of buffers, at least 1.
+ *
+ * @return the new ring, or NULL on failure.
+ */
+struct spsc_ring *new_spsc_ring(size_t buffer_size, unsigned int depth);
+
+void destroy_spsc_ring(struct spsc_ring *r);
+
+/**
+ * spsc_ring_reserve - take the next buffer to fill, as the producer
+ *
+ * Waits for the consumer to release a buffer if every buffer is in flight.
+ * Reserving again without publishing returns the same buffer.
+ *
+ * @return a buffer of @r->buffer_size bytes.
+ */
+char *spsc_ring_reserve(struct spsc_ring *r);
+
+/* Hands the reserved buffer, holding @len bytes, over to the consumer. */
+void spsc_ring_publish(struct spsc_ring *r, size_t len);
+
+/* Tells the consumer that nothing more will be published, waiting for room to do so. */
+void spsc_ring_close(struct spsc_ring *r);
+
+/**
+ * spsc_ring_try_next - take the oldest published buffer, as the consumer
+ *
+ * @r: the ring.
+ * @buf: return pointer for the buffer, which stays the consumer's until
+ *	spsc_ring_release().
+ * @len: return pointer for the number of bytes in the buffer.
+ *
+ * Never waits.
+ *
+ * @return 0 on success, -EAGAIN if nothing has been published yet, or -ENODATA
+ * once the ring is closed, which it stays.
+ */
+int spsc_ring_try_next(struct spsc_ring *r, char **buf, size_t *len);
+
+/* Whether spsc_ring_try_next() would return a buffer. */
+bool spsc_ring_ready(struct spsc_ring *r);
+
+/* Gives the buffer returned by spsc_ring_try_next() back to the producer. */
+void spsc_ring_release(struct spsc_ring *r);
+
+/**
+ * spsc_doorbell_arm - prepare to sleep until a producer publishes
+ *
+ * Every ring must be checked with spsc_ring_ready() after arming, and
+ * spsc_doorbell_wait() only called if none was ready.
+ *
+ * @return the value to pass to spsc_doorbell_wait().
+ */
+uint32_t spsc_doorbell_arm(struct spsc_doorbell *d);
+
+/* Sleeps until a producer rings @d after it was armed, then disarms it. */
+void spsc_doorbell_wait(struct spsc_doorbell *d, uint32_t seen);
+
+void spsc_doorbell_disarm(struct spsc_doorbell *d);
+
+#endif /* SPSC_RING_H */
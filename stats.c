@@ -0,0 +1,386 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Low-overhead execution statistics and their periodic export
+ *
+ * Copyright 2025 Google LLC
+ */
+#include <asm-generic/errno-base.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "stats.h"
+#include "timing.h"
+
+/* Granularity at which the background thread checks for shutdown. */
+#define STATS_POLL_NS 100000000ull
+
+static const double percentiles[] = { 0.5, 0.9, 0.99, 0.999 };
+static const char *percentile_names[] = { "p50", "p90", "p99", "p999" };
+
+/* Exclusive upper bound of a latency bucket, in ns. */
+static uint64_t bucket_limit(unsigned int idx)
+{
+	unsigned int shift;
+
+	if (idx < STATS_SUB_BUCKETS)
+		return idx + 1;
+	shift = idx / STATS_SUB_BUCKETS - 1;
+	if (shift + STATS_SUB_BUCKET_BITS + 1 >= 64)
+		return UINT64_MAX;
+	return (uint64_t)(STATS_SUB_BUCKETS + idx % STATS_SUB_BUCKETS + 1) << shift;
+}
+
+static uint64_t load(const uint64_t *counter)
+{
+	return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+/* Sums every registered struct stats labelled @target into @sum. */
+static void aggregate(struct stats_collector *c, const char *target, struct stats *sum)
+{
+	struct stats *s;
+	size_t i, j;
+
+	memset(sum, 0, sizeof(*sum));
+	sum->target = target;
+	for (i = 0; i < c->num_stats; i++) {
+		s = c->stats[i];
+		if (strcmp(s->target, target) != 0)
+			continue;
+		sum->execs += load(&s->execs);
+		sum->bytes += load(&s->bytes);
+		sum->errors += load(&s->errors);
+		sum->encode_errors += load(&s->encode_errors);
+		sum->hangs += load(&s->hangs);
+		sum->latency_sum += load(&s->latency_sum);
+		for (j = 0; j < STATS_MAX_ERRNO; j++)
+			sum->errnos[j] += load(&s->errnos[j]);
+		for (j = 0; j < STATS_NUM_BUCKETS; j++)
+			sum->latency[j] += load(&s->latency[j]);
+	}
+}
+
+/* Returns true if @idx is the first registered struct stats for its target. */
+static bool first_of_target(struct stats_collector *c, size_t idx)
+{
+	size_t i;
+
+	for (i = 0; i < idx; i++) {
+		if (strcmp(c->stats[i]->target, c->stats[idx]->target) == 0)
+			return false;
+	}
+	return true;
+}
+
+static uint64_t percentile(struct stats *s, double p)
+{
+	uint64_t total = 0;
+	uint64_t seen = 0;
+	unsigned int i;
+
+	for (i = 0; i < STATS_NUM_BUCKETS; i++)
+		total += s->latency[i];
+	if (!total)
+		return 0;
+
+	for (i = 0; i < STATS_NUM_BUCKETS; i++) {
+		seen += s->latency[i];
+		if (seen >= p * total)
+			return bucket_limit(i);
+	}
+	return UINT64_MAX;
+}
+
+static const char *errno_name(int err)
+{
+	static char buf[16];
+	const char *name;
+
+	if (err == STATS_MAX_ERRNO - 1)
+		return "other";
+	name = strerrorname_np(err);
+	if (name)
+		return name;
+	snprintf(buf, sizeof(buf), "%d", err);
+	return buf;
+}
+
+static void dump_json(struct stats_collector *c, FILE *f, double uptime)
+{
+	struct stats sum;
+	bool first_target = true;
+	bool first;
+	size_t i, j;
+
+	fprintf(f, "{\n  \"uptime_sec\": %.3f,\n  \"targets\": [", uptime);
+	for (i = 0; i < c->num_stats; i++) {
+		if (!first_of_target(c, i))
+			continue;
+		aggregate(c, c->stats[i]->target, &sum);
+
+		fprintf(f, "%s\n    {\n", first_target ? "" : ",");
+		first_target = false;
+		fprintf(f, "      \"target\": \"%s\",\n", sum.target);
+		fprintf(f, "      \"execs\": %llu,\n", (unsigned long long)sum.execs);
+		fprintf(f, "      \"execs_per_sec\": %.1f,\n", uptime > 0 ? sum.execs / uptime : 0.0);
+		fprintf(f, "      \"bytes_written\": %llu,\n", (unsigned long long)sum.bytes);
+		fprintf(f, "      \"errors\": %llu,\n", (unsigned long long)sum.errors);
+		fprintf(f, "      \"encode_errors\": %llu,\n", (unsigned long long)sum.encode_errors);
+		fprintf(f, "      \"hangs\": %llu,\n", (unsigned long long)sum.hangs);
+		fprintf(f, "      \"quarantined\": %s,\n", sum.hangs ? "true" : "false");
+
+		fprintf(f, "      \"errno\": {");
+		for (j = 0, first = true; j < STATS_MAX_ERRNO; j++) {
+			if (!sum.errnos[j])
+				continue;
+			fprintf(f, "%s\"%s\": %llu", first ? "" : ", ", errno_name(j),
+				(unsigned long long)sum.errnos[j]);
+			first = false;
+		}
+		fprintf(f, "},\n");
+
+		fprintf(f, "      \"latency_ns\": {\"mean\": %llu",
+			(unsigned long long)(sum.execs ? sum.latency_sum / sum.execs : 0));
+		for (j = 0; j < sizeof(percentiles) / sizeof(percentiles[0]); j++)
+			fprintf(f, ", \"%s\": %llu", percentile_names[j],
+				(unsigned long long)percentile(&sum, percentiles[j]));
+		fprintf(f, "}\n    }");
+	}
+	fprintf(f, "\n  ]\n}\n");
+}
+
+static void dump_prometheus(struct stats_collector *c, FILE *f, double uptime)
+{
+	uint64_t cumulative;
+	struct stats *sums;
+	struct stats *sum;
+	size_t num_sums = 0;
+	size_t i, j;
+
+	/* Samples of one metric family must be contiguous, so aggregate up front. */
+	sums = malloc(c->num_stats * sizeof(*sums));
+	if (!sums && c->num_stats)
+		return;
+	for (i = 0; i < c->num_stats; i++) {
+		if (first_of_target(c, i))
+			aggregate(c, c->stats[i]->target, &sums[num_sums++]);
+	}
+
+	fprintf(f, "# TYPE kfuzztest_uptime_seconds gauge\nkfuzztest_uptime_seconds %.3f\n", uptime);
+
+	fprintf(f, "# TYPE kfuzztest_execs_total counter\n");
+	for (i = 0; i < num_sums; i++)
+		fprintf(f, "kfuzztest_execs_total{target=\"%s\"} %llu\n", sums[i].target,
+			(unsigned long long)sums[i].execs);
+
+	fprintf(f, "# TYPE kfuzztest_bytes_written_total counter\n");
+	for (i = 0; i < num_sums; i++)
+		fprintf(f, "kfuzztest_bytes_written_total{target=\"%s\"} %llu\n", sums[i].target,
+			(unsigned long long)sums[i].bytes);
+
+	fprintf(f, "# TYPE kfuzztest_errors_total counter\n");
+	for (i = 0; i < num_sums; i++) {
+		for (j = 0; j < STATS_MAX_ERRNO; j++) {
+			if (sums[i].errnos[j])
+				fprintf(f, "kfuzztest_errors_total{target=\"%s\",errno=\"%s\"} %llu\n", sums[i].target,
+					errno_name(j), (unsigned long long)sums[i].errnos[j]);
+		}
+	}
+
+	fprintf(f, "# TYPE kfuzztest_encode_errors_total counter\n");
+	for (i = 0; i < num_sums; i++)
+		fprintf(f, "kfuzztest_encode_errors_total{target=\"%s\"} %llu\n", sums[i].target,
+			(unsigned long long)sums[i].encode_errors);
+
+	fprintf(f, "# TYPE kfuzztest_hangs_total counter\n");
+	for (i = 0; i < num_sums; i++)
+		fprintf(f, "kfuzztest_hangs_total{target=\"%s\"} %llu\n", sums[i].target,
+			(unsigned long long)sums[i].hangs);
+
+	fprintf(f, "# TYPE kfuzztest_quarantined gauge\n");
+	for (i = 0; i < num_sums; i++)
+		fprintf(f, "kfuzztest_quarantined{target=\"%s\"} %d\n", sums[i].target, sums[i].hangs > 0);
+
+	fprintf(f, "# TYPE kfuzztest_write_latency_seconds histogram\n");
+	for (i = 0; i < num_sums; i++) {
+		sum = &sums[i];
+		/* Only emit buckets that are populated, plus the mandatory +Inf. */
+		for (j = 0, cumulative = 0; j < STATS_NUM_BUCKETS; j++) {
+			if (!sum->latency[j])
+				continue;
+			cumulative += sum->latency[j];
+			fprintf(f, "kfuzztest_write_latency_seconds_bucket{target=\"%s\",le=\"%.9f\"} %llu\n",
+				sum->target, (double)bucket_limit(j) / NSEC_PER_SEC, (unsigned long long)cumulative);
+		}
+		fprintf(f, "kfuzztest_write_latency_seconds_bucket{target=\"%s\",le=\"+Inf\"} %llu\n", sum->target,
+			(unsigned long long)cumulative);
+		fprintf(f, "kfuzztest_write_latency_seconds_sum{target=\"%s\"} %.9f\n", sum->target,
+			(double)sum->latency_sum / NSEC_PER_SEC);
+		fprintf(f, "kfuzztest_write_latency_seconds_count{target=\"%s\"} %llu\n", sum->target,
+			(unsigned long long)cumulative);
+	}
+	free(sums);
+}
+
+int stats_collector_dump(struct stats_collector *c)
+{
+	double uptime = (double)(now_ns() - c->start_ns) / NSEC_PER_SEC;
+	char tmp_path[4096];
+	FILE *f;
+	int err = 0;
+
+	if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", c->path) >= sizeof(tmp_path))
+		return -ENAMETOOLONG;
+
+	f = fopen(tmp_path, "w");
+	if (!f)
+		return -errno;
+
+	if (c->format == STATS_FORMAT_JSON)
+		dump_json(c, f, uptime);
+	else
+		dump_prometheus(c, f, uptime);
+
+	if (ferror(f))
+		err = -EIO;
+	if (fclose(f) && !err)
+		err = -errno;
+	if (!err && rename(tmp_path, c->path))
+		err = -errno;
+	if (err)
+		unlink(tmp_path);
+	return err;
+}
+
+struct stats_collector *new_stats_collector(const char *path, enum stats_format format, uint64_t interval_ns)
+{
+	struct stats_collector *c;
+
+	c = calloc(1, sizeof(*c));
+	if (!c)
+		return NULL;
+
+	c->path = strdup(path);
+	if (!c->path) {
+		free(c);
+		return NULL;
+	}
+	c->format = format;
+	c->interval_ns = interval_ns;
+	c->start_ns = now_ns();
+	return c;
+}
+
+/*
+ * JSON and Prometheus label values share \\, \" and \n, but only JSON forbids
+ * other control characters, and only Prometheus has no \u escape.
+ */
+char *stats_escape_label(const char *s, enum stats_format format)
+{
+	char *ret;
+	char *p;
+
+	/* Every byte takes at most 6, as "\u001f". */
+	ret = malloc(6 * strlen(s) + 1);
+	if (!ret)
+		return NULL;
+	for (p = ret; *s; s++) {
+		if (*s == '\\' || *s == '"') {
+			*p++ = '\\';
+			*p++ = *s;
+		} else if (*s == '\n') {
+			*p++ = '\\';
+			*p++ = 'n';
+		} else if (format == STATS_FORMAT_JSON && (unsigned char)*s < 0x20) {
+			p += sprintf(p, "\\u%04x", (unsigned char)*s);
+		} else {
+			*p++ = *s;
+		}
+	}
+	*p = '\0';
+	return ret;
+}
+
+struct stats *stats_collector_add(struct stats_collector *c, const char *target)
+{
+	struct stats *s;
+	void *new_ptr;
+
+	if (posix_memalign((void **)&s, __alignof__(struct stats), sizeof(*s)))
+		return NULL;
+	memset(s, 0, sizeof(*s));
+	s->target = stats_escape_label(target, c->format);
+	if (!s->target) {
+		free(s);
+		return NULL;
+	}
+
+	new_ptr = realloc(c->stats, (c->num_stats + 1) * sizeof(struct stats *));
+	if (!new_ptr) {
+		free((void *)s->target);
+		free(s);
+		return NULL;
+	}
+	c->stats = new_ptr;
+	c->stats[c->num_stats++] = s;
+	return s;
+}
+
+static void *collector_thread(void *arg)
+{
+	struct stats_collector *c = arg;
+	struct timespec ts = { .tv_sec = 0, .tv_nsec = STATS_POLL_NS };
+	uint64_t next = now_ns() + c->interval_ns;
+
+	while (!c->stop) {
+		nanosleep(&ts, NULL);
+		if (now_ns() >= next) {
+			stats_collector_dump(c);
+			next += c->interval_ns;
+		}
+	}
+	return NULL;
+}
+
+int stats_collector_start(struct stats_collector *c)
+{
+	int err;
+
+	c->start_ns = now_ns();
+	err = -pthread_create(&c->thread, NULL, collector_thread, c);
+	if (!err)
+		c->running = true;
+	return err;
+}
+
+void destroy_stats_collector(struct stats_collector *c)
+{
+	size_t i;
+
+	if (c->running) {
+		c->stop = true;
+		pthread_join(c->thread, NULL);
+	}
+	stats_collector_dump(c);
+
+	for (i = 0; i < c->num_stats; i++) {
+		free((void *)c->stats[i]->target);
+		free(c->stats[i]);
+	}
+	free(c->stats);
+	free(c->path);
+	free(c);
+}
+
+int parse_stats_format(const char *name, enum stats_format *ret)
+{
+	if (strcmp(name, "json") == 0)
+		*ret = STATS_FORMAT_JSON;
+	else if (strcmp(name, "prometheus") == 0 || strcmp(name, "prom") == 0)
+		*ret = STATS_FORMAT_PROMETHEUS;
+	else
+		return -EINVAL;
+	return 0;
+}
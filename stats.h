@@ -0,0 +1,170 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Low-overhead execution statistics and their periodic export
+ *
+ * Copyright 2025 Google LLC
+ */
+#ifndef STATS_H
+#define STATS_H 1
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+ * Latencies are bucketed by their most significant bit, with each power of two
+ * split into STATS_SUB_BUCKETS linear sub-buckets. This bounds the relative
+ * error of a reported percentile to 25% while covering the full u64 range.
+ */
+#define STATS_SUB_BUCKET_BITS 2
+#define STATS_SUB_BUCKETS (1 << STATS_SUB_BUCKET_BITS)
+#define STATS_NUM_BUCKETS ((64 - STATS_SUB_BUCKET_BITS + 1) * STATS_SUB_BUCKETS)
+
+/* errno values at or above this are counted together. */
+#define STATS_MAX_ERRNO 256
+
+/**
+ * struct stats - counters for one worker's injections into one target
+ *
+ * @target: name of the target, used to label the exported counters, and
+ *	escaped to be quoted in the collector's format.
+ * @execs: number of inputs written to the target.
+ * @bytes: total size of those inputs.
+ * @errors: number of writes that failed.
+ * @encode_errors: number of inputs that could not be encoded.
+ * @hangs: number of writes that exceeded the watchdog's timeout. Written by
+ *	the watchdog thread rather than the worker.
+ * @latency_sum: sum of all write latencies, in ns.
+ * @errnos: failed writes, indexed by errno.
+ * @latency: histogram of write latencies, see stats_bucket().
+ *
+ * A struct stats has a single writer, so recording is a handful of plain
+ * increments. Readers in other threads use relaxed atomic loads and may see
+ * counters that are slightly out of date with one another.
+ */
+struct stats {
+	const char *target;
+	uint64_t execs;
+	uint64_t bytes;
+	uint64_t errors;
+	uint64_t encode_errors;
+	uint64_t hangs;
+	uint64_t latency_sum;
+	uint64_t errnos[STATS_MAX_ERRNO];
+	uint64_t latency[STATS_NUM_BUCKETS];
+} __attribute__((aligned(64)));
+
+enum stats_format {
+	STATS_FORMAT_JSON,
+	STATS_FORMAT_PROMETHEUS,
+};
+
+/**
+ * struct stats_collector - periodically exports a set of struct stats
+ *
+ * Counters of all registered struct stats with the same target are summed.
+ * Every dump is written to a temporary file which is then renamed over @path,
+ * so readers never observe a partial dump.
+ */
+struct stats_collector {
+	char *path;
+	enum stats_format format;
+	uint64_t interval_ns;
+	uint64_t start_ns;
+
+	struct stats **stats;
+	size_t num_stats;
+
+	pthread_t thread;
+	bool running;
+	volatile bool stop;
+};
+
+static inline void stats_inc(uint64_t *counter, uint64_t n)
+{
+	__atomic_store_n(counter, *counter + n, __ATOMIC_RELAXED);
+}
+
+static inline unsigned int stats_bucket(uint64_t ns)
+{
+	unsigned int msb;
+
+	if (ns < STATS_SUB_BUCKETS)
+		return ns;
+	msb = 63 - __builtin_clzll(ns);
+	return (msb - STATS_SUB_BUCKET_BITS + 1) * STATS_SUB_BUCKETS +
+	       ((ns >> (msb - STATS_SUB_BUCKET_BITS)) & (STATS_SUB_BUCKETS - 1));
+}
+
+/**
+ * stats_record - account for one write to a target
+ *
+ * @s: the writer's struct stats.
+ * @num_bytes: size of the input.
+ * @err: 0 or the negative errno returned by the write.
+ * @latency_ns: duration of the write.
+ */
+static inline void stats_record(struct stats *s, size_t num_bytes, int err, uint64_t latency_ns)
+{
+	stats_inc(&s->execs, 1);
+	stats_inc(&s->bytes, num_bytes);
+	stats_inc(&s->latency_sum, latency_ns);
+	stats_inc(&s->latency[stats_bucket(latency_ns)], 1);
+	if (err) {
+		stats_inc(&s->errors, 1);
+		stats_inc(&s->errnos[-err < STATS_MAX_ERRNO ? -err : STATS_MAX_ERRNO - 1], 1);
+	}
+}
+
+/**
+ * new_stats_collector - create a collector dumping to a file
+ *
+ * @path: file to which every dump is written.
+ * @format: output format of the dumps.
+ * @interval_ns: time between dumps once started.
+ *
+ * @return the new collector, or NULL on failure.
+ */
+struct stats_collector *new_stats_collector(const char *path, enum stats_format format, uint64_t interval_ns);
+
+/**
+ * stats_collector_add - allocate and register a struct stats for a target
+ *
+ * Must be called before stats_collector_start().
+ *
+ * @return the new, zeroed counters, owned by the collector, or NULL.
+ */
+struct stats *stats_collector_add(struct stats_collector *c, const char *target);
+
+/**
+ * stats_collector_start - start dumping periodically from a background thread
+ *
+ * @return 0 on success or a negative errno on failure.
+ */
+int stats_collector_start(struct stats_collector *c);
+
+/**
+ * stats_collector_dump - write one dump of all counters to the output file
+ *
+ * @return 0 on success or a negative errno on failure.
+ */
+int stats_collector_dump(struct stats_collector *c);
+
+/**
+ * destroy_stats_collector - stop the background thread, write a final dump
+ * and release all counters
+ */
+void destroy_stats_collector(struct stats_collector *c);
+
+int parse_stats_format(const char *name, enum stats_format *ret);
+
+/**
+ * stats_escape_label - copy a label value with the escapes it needs between
+ * double quotes in @format
+ *
+ * @return the escaped copy, to be freed by the caller, or NULL on failure.
+ */
+char *stats_escape_label(const char *s, enum stats_format format);
+
+#endif /* STATS_H */
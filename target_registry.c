@@ -0,0 +1,247 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Registry of KFuzzTest targets and their cached debugfs input handles
+ *
+ * Copyright 2025 Google LLC
+ */
+#include <asm-generic/errno-base.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "target_registry.h"
+
+static int target_open(struct kfuzztest_target *t)
+{
+	int fd;
+
+	fd = openat(AT_FDCWD, t->input_path, O_WRONLY | O_CLOEXEC, 0);
+	if (fd < 0)
+		return -errno;
+
+	if (t->fd >= 0)
+		close(t->fd);
+	t->fd = fd;
+	return 0;
+}
+
+void destroy_target(struct kfuzztest_target *t)
+{
+	if (t->fd >= 0)
+		close(t->fd);
+	free(t->name);
+	free(t->input_path);
+	free(t);
+}
+
+static struct kfuzztest_target *new_target(const char *root, const char *name)
+{
+	struct kfuzztest_target *t;
+
+	t = calloc(1, sizeof(*t));
+	if (!t)
+		return NULL;
+
+	t->fd = -1;
+	t->name = strdup(name);
+	if (!t->name || asprintf(&t->input_path, "%s/%s/input", root, name) < 0) {
+		free(t->name);
+		free(t);
+		return NULL;
+	}
+	return t;
+}
+
+struct kfuzztest_target *clone_target(const struct kfuzztest_target *t)
+{
+	struct kfuzztest_target *ret;
+
+	ret = calloc(1, sizeof(*ret));
+	if (!ret)
+		return NULL;
+
+	ret->fd = -1;
+	ret->name = strdup(t->name);
+	ret->input_path = strdup(t->input_path);
+	if (!ret->name || !ret->input_path || target_open(ret)) {
+		destroy_target(ret);
+		return NULL;
+	}
+	return ret;
+}
+
+static int add_target(struct target_registry *reg, struct kfuzztest_target *t)
+{
+	void *new_ptr;
+
+	new_ptr = realloc(reg->targets, (reg->num_targets + 1) * sizeof(struct kfuzztest_target *));
+	if (!new_ptr)
+		return -ENOMEM;
+
+	reg->targets = new_ptr;
+	reg->targets[reg->num_targets++] = t;
+	return 0;
+}
+
+static bool has_input_file(const char *root, const char *name)
+{
+	struct stat st;
+	char buf[512];
+
+	if (snprintf(buf, sizeof(buf), "%s/%s/input", root, name) >= sizeof(buf))
+		return false;
+	return stat(buf, &st) == 0 && !S_ISDIR(st.st_mode);
+}
+
+static int discover_targets(struct target_registry *reg)
+{
+	struct kfuzztest_target *t;
+	struct dirent *ent;
+	DIR *dir;
+	int err = 0;
+
+	dir = opendir(reg->root);
+	if (!dir)
+		return -errno;
+
+	while ((ent = readdir(dir))) {
+		if (ent->d_name[0] == '.')
+			continue;
+		if (!has_input_file(reg->root, ent->d_name))
+			continue;
+
+		t = new_target(reg->root, ent->d_name);
+		if (!t) {
+			err = -ENOMEM;
+			break;
+		}
+		/* Failing to open one target must not prevent fuzzing the rest. */
+		target_open(t);
+		if ((err = add_target(reg, t))) {
+			destroy_target(t);
+			break;
+		}
+	}
+	closedir(dir);
+	return err;
+}
+
+struct target_registry *new_target_registry(const char *root)
+{
+	struct target_registry *reg;
+
+	reg = calloc(1, sizeof(*reg));
+	if (!reg)
+		return NULL;
+
+	reg->root = strdup(root ? root : KFUZZTEST_DEBUGFS_ROOT);
+	if (!reg->root) {
+		free(reg);
+		return NULL;
+	}
+
+	if (discover_targets(reg)) {
+		destroy_target_registry(reg);
+		return NULL;
+	}
+	return reg;
+}
+
+void destroy_target_registry(struct target_registry *reg)
+{
+	size_t i;
+
+	for (i = 0; i < reg->num_targets; i++)
+		destroy_target(reg->targets[i]);
+	free(reg->targets);
+	free(reg->root);
+	free(reg);
+}
+
+struct kfuzztest_target *registry_get(struct target_registry *reg, const char *name)
+{
+	struct kfuzztest_target *t;
+	size_t i;
+
+	for (i = 0; i < reg->num_targets; i++) {
+		if (strcmp(reg->targets[i]->name, name) == 0)
+			return reg->targets[i];
+	}
+
+	if (strchr(name, '/') || !has_input_file(reg->root, name))
+		return NULL;
+
+	t = new_target(reg->root, name);
+	if (!t)
+		return NULL;
+	if (add_target(reg, t)) {
+		destroy_target(t);
+		return NULL;
+	}
+	target_open(t);
+	return t;
+}
+
+/*
+ * Whether the input file behind @t's descriptor has been removed, which
+ * fstat() reports through the descriptor itself without walking the path.
+ */
+static bool target_removed(struct kfuzztest_target *t)
+{
+	struct stat st;
+
+	if (fstat(t->fd, &st))
+		return true;
+	return st.st_nlink == 0;
+}
+
+bool target_recover(struct kfuzztest_target *t, int err)
+{
+	/*
+	 * A debugfs file that was removed fails writes with -EIO, -ENODEV or
+	 * -ESTALE, but so may the target itself for a bad input. Retrying
+	 * then would inject the same input twice, and inputs that merely fail
+	 * must not cost a reopen each, so only reopen once the file is gone.
+	 */
+	switch (err) {
+	case -EBADF:
+		break;
+	case -EIO:
+	case -ESTALE:
+	case -ENODEV:
+		if (!target_removed(t))
+			return false;
+		break;
+	default:
+		return false;
+	}
+	return target_open(t) == 0;
+}
+
+int target_write(struct kfuzztest_target *t, const char *data, size_t data_size)
+{
+	int err;
+
+	if (t->fd < 0 && (err = target_open(t)))
+		return err;
+
+	/*
+	 * The descriptor is reused across inputs, so write at offset 0 rather
+	 * than at the file position left behind by the previous input.
+	 */
+	if (pwrite(t->fd, data, data_size, 0) >= 0)
+		return 0;
+
+	err = -errno;
+	if (!target_recover(t, err))
+		return err;
+
+	if (pwrite(t->fd, data, data_size, 0) < 0)
+		return -errno;
+	return 0;
+}
@@ -0,0 +1,108 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Registry of KFuzzTest targets and their cached debugfs input handles
+ *
+ * Copyright 2025 Google LLC
+ */
+#ifndef TARGET_REGISTRY_H
+#define TARGET_REGISTRY_H 1
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <sys/types.h>
+
+#define KFUZZTEST_DEBUGFS_ROOT "/sys/kernel/debug/kfuzztest"
+
+/**
+ * struct kfuzztest_target - a fuzz target and its open input file
+ *
+ * @name: the target's directory name under the registry root.
+ * @input_path: full path of the target's input file.
+ * @fd: cached write-only descriptor for @input_path, or -1 if not yet open.
+ */
+struct kfuzztest_target {
+	char *name;
+	char *input_path;
+	int fd;
+};
+
+/**
+ * struct target_registry - the set of targets found under a debugfs root
+ *
+ * Targets are discovered once when the registry is created, and their input
+ * files are kept open so that an injection costs a single write().
+ */
+struct target_registry {
+	char *root;
+	struct kfuzztest_target **targets;
+	size_t num_targets;
+};
+
+/**
+ * new_target_registry - enumerate and open every target under a root
+ *
+ * @root: the KFuzzTest debugfs directory, or NULL for KFUZZTEST_DEBUGFS_ROOT.
+ *
+ * Any directory under @root containing an `input` file is registered. Input
+ * files that cannot be opened yet are retried on first use.
+ *
+ * @return the new registry, or NULL on failure.
+ */
+struct target_registry *new_target_registry(const char *root);
+
+void destroy_target_registry(struct target_registry *reg);
+
+/**
+ * registry_get - look up a target by name
+ *
+ * @reg: an initialized struct target_registry.
+ * @name: the target's directory name.
+ *
+ * Targets that appeared after the registry was created are registered on
+ * demand.
+ *
+ * @return the target, or NULL if @root has no such target.
+ */
+struct kfuzztest_target *registry_get(struct target_registry *reg, const char *name);
+
+/**
+ * clone_target - open a private handle on an existing target
+ *
+ * @t: a registered target.
+ *
+ * The clone has its own descriptor, so it can be written to from another
+ * thread without sharing any state with @t. It is owned by the caller and
+ * must be released with destroy_target().
+ *
+ * @return the new handle, or NULL on failure.
+ */
+struct kfuzztest_target *clone_target(const struct kfuzztest_target *t);
+
+void destroy_target(struct kfuzztest_target *t);
+
+/**
+ * target_write - write one input to a target's input file
+ *
+ * @t: a registered target.
+ * @data: the encoded input.
+ * @data_size: the size of @data in bytes.
+ *
+ * If the cached descriptor has gone stale (e.g., the module providing the
+ * target was reloaded), the input file is reopened and the write retried.
+ *
+ * @return 0 on success or a negative errno on failure.
+ */
+int target_write(struct kfuzztest_target *t, const char *data, size_t data_size);
+
+/**
+ * target_recover - reopen a target's input file after a failed write
+ *
+ * @t: the target that was written to.
+ * @err: the negative errno returned by the write.
+ *
+ * @return true if @err was caused by a stale descriptor or a removed input
+ * file that has now been reopened, in which case the write should be retried.
+ */
+bool target_recover(struct kfuzztest_target *t, int err);
+
+#endif /* TARGET_REGISTRY_H */
@@ -0,0 +1,345 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * io_uring backend for batched injection of KFuzzTest inputs
+ *
+ * Copyright 2025 Google LLC
+ */
+#include <asm-generic/errno-base.h>
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "timing.h"
+#include "uring_backend.h"
+
+#define URING_MIN_SLOT_SIZE 4096
+
+static int sys_io_uring_setup(unsigned int entries, struct io_uring_params *p)
+{
+	return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags)
+{
+	return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned int opcode, void *arg, unsigned int nr_args)
+{
+	return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static int map_rings(struct uring_backend *u, struct io_uring_params *p)
+{
+	u->sq_ring_size = p->sq_off.array + p->sq_entries * sizeof(unsigned int);
+	u->cq_ring_size = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+	u->sqes_size = p->sq_entries * sizeof(struct io_uring_sqe);
+
+	if (p->features & IORING_FEAT_SINGLE_MMAP) {
+		if (u->cq_ring_size > u->sq_ring_size)
+			u->sq_ring_size = u->cq_ring_size;
+		u->cq_ring_size = 0;
+	}
+
+	u->sq_ring = mmap(NULL, u->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ring_fd,
+			  IORING_OFF_SQ_RING);
+	if (u->sq_ring == MAP_FAILED)
+		return -errno;
+
+	u->cq_ring = u->sq_ring;
+	if (u->cq_ring_size) {
+		u->cq_ring = mmap(NULL, u->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+				  u->ring_fd, IORING_OFF_CQ_RING);
+		if (u->cq_ring == MAP_FAILED)
+			return -errno;
+	}
+
+	u->sqes = mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ring_fd,
+		       IORING_OFF_SQES);
+	if (u->sqes == MAP_FAILED)
+		return -errno;
+
+	u->sq_head = (unsigned int *)((char *)u->sq_ring + p->sq_off.head);
+	u->sq_tail = (unsigned int *)((char *)u->sq_ring + p->sq_off.tail);
+	u->sq_mask = (unsigned int *)((char *)u->sq_ring + p->sq_off.ring_mask);
+	u->sq_array = (unsigned int *)((char *)u->sq_ring + p->sq_off.array);
+	u->cq_head = (unsigned int *)((char *)u->cq_ring + p->cq_off.head);
+	u->cq_tail = (unsigned int *)((char *)u->cq_ring + p->cq_off.tail);
+	u->cq_mask = (unsigned int *)((char *)u->cq_ring + p->cq_off.ring_mask);
+	u->cqes = (struct io_uring_cqe *)((char *)u->cq_ring + p->cq_off.cqes);
+	return 0;
+}
+
+static void unmap_rings(struct uring_backend *u)
+{
+	if (u->sqes && u->sqes != MAP_FAILED)
+		munmap(u->sqes, u->sqes_size);
+	if (u->cq_ring_size && u->cq_ring && u->cq_ring != MAP_FAILED)
+		munmap(u->cq_ring, u->cq_ring_size);
+	if (u->sq_ring && u->sq_ring != MAP_FAILED)
+		munmap(u->sq_ring, u->sq_ring_size);
+}
+
+static void free_slots(struct uring_backend *u)
+{
+	if (u->slot_mem) {
+		sys_io_uring_register(u->ring_fd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+		munmap(u->slot_mem, u->slot_size * u->depth);
+	}
+	u->slot_mem = NULL;
+	u->slot_size = 0;
+}
+
+/* (Re)allocates the slot pool so that every slot can hold @len bytes. */
+static int alloc_slots(struct uring_backend *u, size_t len)
+{
+	struct iovec *iovs;
+	size_t slot_size;
+	unsigned int i;
+	int err = 0;
+
+	slot_size = URING_MIN_SLOT_SIZE;
+	while (slot_size < len)
+		slot_size *= 2;
+
+	free_slots(u);
+	u->slot_mem = mmap(NULL, slot_size * u->depth, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (u->slot_mem == MAP_FAILED) {
+		u->slot_mem = NULL;
+		return -ENOMEM;
+	}
+	u->slot_size = slot_size;
+
+	iovs = calloc(u->depth, sizeof(*iovs));
+	if (!iovs)
+		return -ENOMEM;
+	for (i = 0; i < u->depth; i++) {
+		u->slots[i].buf = u->slot_mem + i * slot_size;
+		iovs[i].iov_base = u->slots[i].buf;
+		iovs[i].iov_len = slot_size;
+	}
+	if (sys_io_uring_register(u->ring_fd, IORING_REGISTER_BUFFERS, iovs, u->depth) < 0)
+		err = -errno;
+	free(iovs);
+	return err;
+}
+
+struct uring_backend *new_uring_backend(struct kfuzztest_target *target, unsigned int depth,
+					uring_complete_fn complete, void *complete_arg)
+{
+	struct io_uring_params p = { 0 };
+	struct uring_backend *u;
+	unsigned int i;
+
+	if (target->fd < 0)
+		return NULL;
+
+	u = calloc(1, sizeof(*u));
+	if (!u)
+		return NULL;
+
+	u->target = target;
+	u->complete = complete;
+	u->complete_arg = complete_arg;
+	u->ring_fd = sys_io_uring_setup(depth, &p);
+	if (u->ring_fd < 0) {
+		free(u);
+		return NULL;
+	}
+	/* The kernel may round the number of entries up. */
+	u->depth = p.sq_entries < depth ? p.sq_entries : depth;
+
+	if (map_rings(u, &p))
+		goto fail;
+
+	u->slots = calloc(u->depth, sizeof(*u->slots));
+	u->free_slots = calloc(u->depth, sizeof(*u->free_slots));
+	if (!u->slots || !u->free_slots)
+		goto fail;
+	for (i = 0; i < u->depth; i++)
+		u->free_slots[i] = i;
+	u->num_free = u->depth;
+
+	u->registered_fd = target->fd;
+	if (sys_io_uring_register(u->ring_fd, IORING_REGISTER_FILES, &u->registered_fd, 1) < 0)
+		goto fail;
+	if (alloc_slots(u, URING_MIN_SLOT_SIZE))
+		goto fail;
+	return u;
+
+fail:
+	free_slots(u);
+	free(u->slots);
+	free(u->free_slots);
+	unmap_rings(u);
+	close(u->ring_fd);
+	free(u);
+	return NULL;
+}
+
+/*
+ * Handles a failed write. If the registered descriptor went stale, the target
+ * is reopened, the input is retried synchronously, and the ring is pointed at
+ * the new descriptor for subsequent writes.
+ */
+static int recover(struct uring_backend *u, struct uring_slot *slot, int err)
+{
+	struct io_uring_files_update update = { .offset = 0 };
+
+	if (!target_recover(u->target, err))
+		return err;
+
+	err = target_write(u->target, slot->buf, slot->len);
+	if (u->target->fd >= 0 && u->target->fd != u->registered_fd) {
+		u->registered_fd = u->target->fd;
+		update.fds = (uintptr_t)&u->registered_fd;
+		sys_io_uring_register(u->ring_fd, IORING_REGISTER_FILES_UPDATE, &update, 1);
+	}
+	return err;
+}
+
+static unsigned int reap(struct uring_backend *u)
+{
+	struct uring_completion c;
+	struct io_uring_cqe *cqe;
+	struct uring_slot *slot;
+	unsigned int reaped = 0;
+	unsigned int head;
+	uint64_t now;
+
+	head = *u->cq_head;
+	now = now_ns();
+	while (head != __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE)) {
+		cqe = &u->cqes[head & *u->cq_mask];
+		slot = &u->slots[cqe->user_data];
+
+		c.res = cqe->res < 0 ? recover(u, slot, cqe->res) : 0;
+		c.seq = slot->seq;
+		c.data = slot->buf;
+		c.len = slot->len;
+		c.latency_ns = now - slot->submitted_ns;
+		if (u->complete)
+			u->complete(u->complete_arg, &c);
+
+		u->free_slots[u->num_free++] = cqe->user_data;
+		head++;
+		reaped++;
+	}
+	__atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+	return reaped;
+}
+
+/* Stamps the inputs that the next io_uring_enter() will submit. */
+static void stamp_submitted(struct uring_backend *u)
+{
+	unsigned int tail = *u->sq_tail;
+	unsigned int i;
+	uint64_t now;
+
+	now = now_ns();
+	for (i = tail - u->to_submit; i != tail; i++)
+		u->slots[u->sqes[i & *u->sq_mask].user_data].submitted_ns = now;
+}
+
+static int enter(struct uring_backend *u, unsigned int min_complete)
+{
+	unsigned int flags = min_complete ? IORING_ENTER_GETEVENTS : 0;
+	int ret;
+
+	if (u->to_submit)
+		stamp_submitted(u);
+	do {
+		ret = sys_io_uring_enter(u->ring_fd, u->to_submit, min_complete, flags);
+	} while (ret < 0 && errno == EINTR);
+	if (ret < 0)
+		return -errno;
+	u->to_submit -= ret < u->to_submit ? ret : u->to_submit;
+	return 0;
+}
+
+int uring_submit(struct uring_backend *u)
+{
+	int err;
+
+	if (u->to_submit && (err = enter(u, 0)))
+		return err;
+	reap(u);
+	return 0;
+}
+
+int uring_drain(struct uring_backend *u)
+{
+	int err;
+
+	while (u->num_free < u->depth) {
+		if ((err = enter(u, 1)))
+			return err;
+		reap(u);
+	}
+	return 0;
+}
+
+char *uring_get_slot(struct uring_backend *u, size_t len, unsigned int *slot_ret)
+{
+	if (len > u->slot_size) {
+		if (uring_drain(u) || alloc_slots(u, len))
+			return NULL;
+	}
+
+	reap(u);
+	while (u->num_free == 0) {
+		if (enter(u, 1))
+			return NULL;
+		reap(u);
+	}
+	*slot_ret = u->free_slots[--u->num_free];
+	return u->slots[*slot_ret].buf;
+}
+
+void uring_put_slot(struct uring_backend *u, unsigned int slot)
+{
+	u->free_slots[u->num_free++] = slot;
+}
+
+void uring_queue(struct uring_backend *u, unsigned int slot, size_t len, uint64_t seq)
+{
+	struct io_uring_sqe *sqe;
+	unsigned int tail;
+	unsigned int idx;
+
+	u->slots[slot].len = len;
+	u->slots[slot].seq = seq;
+
+	/* At most depth slots are ever in flight, so the SQ cannot overflow. */
+	tail = *u->sq_tail;
+	idx = tail & *u->sq_mask;
+	sqe = &u->sqes[idx];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = IORING_OP_WRITE_FIXED;
+	sqe->flags = IOSQE_FIXED_FILE;
+	sqe->fd = 0;
+	sqe->addr = (uintptr_t)u->slots[slot].buf;
+	sqe->len = len;
+	sqe->off = 0;
+	sqe->buf_index = slot;
+	sqe->user_data = slot;
+
+	u->sq_array[idx] = idx;
+	__atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	u->to_submit++;
+}
+
+void destroy_uring_backend(struct uring_backend *u)
+{
+	uring_drain(u);
+	free_slots(u);
+	free(u->slots);
+	free(u->free_slots);
+	unmap_rings(u);
+	close(u->ring_fd);
+	free(u);
+}
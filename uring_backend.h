@@ -0,0 +1,162 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * io_uring backend for batched injection of KFuzzTest inputs
+ *
+ * Copyright 2025 Google LLC
+ */
+#ifndef URING_BACKEND_H
+#define URING_BACKEND_H 1
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "target_registry.h"
+
+#define URING_DEFAULT_DEPTH 32
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+/**
+ * struct uring_slot - a registered buffer holding one in-flight input
+ *
+ * @buf: the registered buffer.
+ * @len: number of valid bytes in @buf.
+ * @seq: caller-chosen sequence number identifying the input.
+ * @submitted_ns: time at which the input was handed to the kernel.
+ */
+struct uring_slot {
+	char *buf;
+	size_t len;
+	uint64_t seq;
+	uint64_t submitted_ns;
+};
+
+/**
+ * struct uring_completion - the outcome of one injected input
+ *
+ * @seq: the sequence number passed to uring_queue().
+ * @res: 0 on success or a negative errno, as for target_write().
+ * @data: the input that produced @res. Only valid during the callback.
+ * @len: the size of @data in bytes.
+ * @latency_ns: time from submitting the input to reaping its completion. Time
+ *	spent filling the batch before submission is not included, so that
+ *	this compares with the latency of a synchronous write.
+ */
+struct uring_completion {
+	uint64_t seq;
+	int res;
+	const char *data;
+	size_t len;
+	uint64_t latency_ns;
+};
+
+typedef void (*uring_complete_fn)(void *arg, const struct uring_completion *c);
+
+/**
+ * struct uring_backend - an io_uring instance writing to a single target
+ *
+ * The target's descriptor and a fixed pool of input buffers are registered
+ * with the ring up front, so each submitted write is an IORING_OP_WRITE_FIXED
+ * on a fixed file. Buffers are recycled as their completions are reaped.
+ */
+struct uring_backend {
+	int ring_fd;
+	unsigned int depth;
+
+	void *sq_ring;
+	size_t sq_ring_size;
+	unsigned int *sq_head;
+	unsigned int *sq_tail;
+	unsigned int *sq_mask;
+	unsigned int *sq_array;
+	struct io_uring_sqe *sqes;
+	size_t sqes_size;
+
+	void *cq_ring;
+	size_t cq_ring_size;
+	unsigned int *cq_head;
+	unsigned int *cq_tail;
+	unsigned int *cq_mask;
+	struct io_uring_cqe *cqes;
+
+	struct kfuzztest_target *target;
+	int registered_fd;
+
+	char *slot_mem;
+	size_t slot_size;
+	struct uring_slot *slots;
+	unsigned int *free_slots;
+	unsigned int num_free;
+	unsigned int to_submit;
+
+	uring_complete_fn complete;
+	void *complete_arg;
+};
+
+/**
+ * new_uring_backend - set up an io_uring instance for a target
+ *
+ * @target: the target to write to. Must outlive the backend.
+ * @depth: number of inputs that may be in flight at once.
+ * @complete: called once per reaped completion.
+ * @complete_arg: passed to @complete.
+ *
+ * @return the new backend, or NULL if io_uring is unavailable, in which case
+ * the caller should fall back to synchronous writes.
+ */
+struct uring_backend *new_uring_backend(struct kfuzztest_target *target, unsigned int depth,
+					uring_complete_fn complete, void *complete_arg);
+
+/**
+ * destroy_uring_backend - wait for in-flight inputs and release the ring
+ */
+void destroy_uring_backend(struct uring_backend *u);
+
+/**
+ * uring_get_slot - obtain a free buffer for the next input
+ *
+ * @u: an initialized backend.
+ * @len: required size of the buffer.
+ * @slot_ret: return pointer for the slot index.
+ *
+ * Reaps completions, blocking if every buffer is in flight. The buffer pool
+ * is grown (after draining the ring) if @len exceeds its current slot size.
+ *
+ * @return the buffer to encode into, or NULL on failure.
+ */
+char *uring_get_slot(struct uring_backend *u, size_t len, unsigned int *slot_ret);
+
+/* Returns a slot from uring_get_slot() that is not going to be queued after all. */
+void uring_put_slot(struct uring_backend *u, unsigned int slot);
+
+/**
+ * uring_queue - queue a filled slot for writing
+ *
+ * @u: an initialized backend.
+ * @slot: a slot returned by uring_get_slot().
+ * @len: number of bytes written into the slot.
+ * @seq: sequence number reported back with the slot's completion.
+ *
+ * The write is not submitted until uring_submit() is called.
+ */
+void uring_queue(struct uring_backend *u, unsigned int slot, size_t len, uint64_t seq);
+
+/**
+ * uring_submit - submit all queued writes with a single io_uring_enter()
+ *
+ * Completions that are already available are reaped without blocking.
+ *
+ * @return 0 on success or a negative errno on failure.
+ */
+int uring_submit(struct uring_backend *u);
+
+/**
+ * uring_drain - submit queued writes and wait for every completion
+ *
+ * @return 0 on success or a negative errno on failure.
+ */
+int uring_drain(struct uring_backend *u);
+
+#endif /* URING_BACKEND_H */
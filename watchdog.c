@@ -0,0 +1,226 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Watchdog detecting inputs on which a target hangs
+ *
+ * Copyright 2025 Google LLC
+ */
+#include <asm-generic/errno-base.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "watchdog.h"
+
+/* Sent to a hung worker to interrupt its write. */
+#define WATCHDOG_SIGNAL SIGUSR1
+
+/* Bounds on how often the watchdog wakes up to look at the slots. */
+#define WATCHDOG_MIN_POLL_NS 1000000ull
+#define WATCHDOG_MAX_POLL_NS 100000000ull
+
+static void handle_watchdog_signal(int sig)
+{
+}
+
+struct watchdog *new_watchdog(uint64_t timeout_ns, const char *hang_dir, struct stats_collector *sc)
+{
+	struct watchdog *wd;
+
+	wd = calloc(1, sizeof(*wd));
+	if (!wd)
+		return NULL;
+
+	wd->hang_dir = strdup(hang_dir);
+	if (!wd->hang_dir) {
+		free(wd);
+		return NULL;
+	}
+	wd->timeout_ns = timeout_ns;
+	wd->sc = sc;
+	return wd;
+}
+
+static struct watchdog_target *get_target(struct watchdog *wd, const char *name)
+{
+	struct watchdog_target *t;
+	void *new_ptr;
+	size_t i;
+
+	for (i = 0; i < wd->num_targets; i++) {
+		if (strcmp(wd->targets[i]->name, name) == 0)
+			return wd->targets[i];
+	}
+
+	t = calloc(1, sizeof(*t));
+	if (!t)
+		return NULL;
+	t->name = strdup(name);
+	new_ptr = realloc(wd->targets, (wd->num_targets + 1) * sizeof(struct watchdog_target *));
+	if (!t->name || !new_ptr) {
+		free(t->name);
+		free(t);
+		return NULL;
+	}
+	wd->targets = new_ptr;
+	wd->targets[wd->num_targets++] = t;
+	return t;
+}
+
+struct watchdog_slot *watchdog_add(struct watchdog *wd, const char *target, struct stats *stats)
+{
+	struct watchdog_slot *s;
+	void *new_ptr;
+
+	if (posix_memalign((void **)&s, __alignof__(struct watchdog_slot), sizeof(*s)))
+		return NULL;
+	memset(s, 0, sizeof(*s));
+	s->stats = stats;
+	s->target = get_target(wd, target);
+	if (!s->target) {
+		free(s);
+		return NULL;
+	}
+
+	new_ptr = realloc(wd->slots, (wd->num_slots + 1) * sizeof(struct watchdog_slot *));
+	if (!new_ptr) {
+		free(s);
+		return NULL;
+	}
+	wd->slots = new_ptr;
+	wd->slots[wd->num_slots++] = s;
+	return s;
+}
+
+/* Saves the input that @s started writing at @start, unless the write has since returned. */
+static void save_input(struct watchdog *wd, struct watchdog_slot *s, uint64_t start, char *path, size_t path_size)
+{
+	FILE *f;
+
+	snprintf(path, path_size, "%s/hang-%s-%llu.bin", wd->hang_dir, s->target->name, (unsigned long long)start);
+
+	/* Pairs with watch_end(): either we see the write return, or it waits for us. */
+	__atomic_store_n(&s->busy, 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&s->start_ns, __ATOMIC_SEQ_CST) != start) {
+		snprintf(path, path_size, "(returned)");
+		goto out;
+	}
+	f = fopen(path, "wb");
+	if (!f || fwrite(s->data, 1, s->len, f) != s->len)
+		snprintf(path, path_size, "(not saved: %s)", strerror(errno));
+	if (f)
+		fclose(f);
+out:
+	__atomic_store_n(&s->busy, 0, __ATOMIC_SEQ_CST);
+}
+
+static void report_hang(struct watchdog *wd, struct watchdog_slot *s, uint64_t start, uint64_t elapsed)
+{
+	char path[4096];
+
+	s->reported = start;
+	save_input(wd, s, start, path, sizeof(path));
+	if (s->stats)
+		stats_inc(&s->stats->hangs, 1);
+	__atomic_store_n(&s->target->quarantined, true, __ATOMIC_RELAXED);
+
+	printf("watchdog: %s hung for %llu ms on a %zu-byte input, saved to %s; quarantining it\n", s->target->name,
+	       (unsigned long long)(elapsed / 1000000), s->len, path);
+	fflush(stdout);
+	pthread_kill(s->thread, WATCHDOG_SIGNAL);
+}
+
+static void give_up(struct watchdog *wd)
+{
+	printf("watchdog: hung writes could not be interrupted and no worker is making progress, exiting\n");
+	fflush(stdout);
+	if (wd->sc)
+		stats_collector_dump(wd->sc);
+	_exit(WATCHDOG_EXIT_STATUS);
+}
+
+static void *watchdog_thread(void *arg)
+{
+	struct watchdog *wd = arg;
+	uint64_t poll_ns = wd->timeout_ns / 4;
+	uint64_t last_completed = 0;
+	uint64_t last_progress;
+	uint64_t completed;
+	uint64_t elapsed;
+	uint64_t start;
+	uint64_t now;
+	struct timespec ts;
+	bool stuck;
+	size_t i;
+
+	if (poll_ns < WATCHDOG_MIN_POLL_NS)
+		poll_ns = WATCHDOG_MIN_POLL_NS;
+	if (poll_ns > WATCHDOG_MAX_POLL_NS)
+		poll_ns = WATCHDOG_MAX_POLL_NS;
+	ts = (struct timespec){ .tv_sec = poll_ns / NSEC_PER_SEC, .tv_nsec = poll_ns % NSEC_PER_SEC };
+	last_progress = now_ns();
+
+	while (!wd->stop) {
+		nanosleep(&ts, NULL);
+		now = now_ns();
+		completed = 0;
+		stuck = false;
+
+		for (i = 0; i < wd->num_slots; i++) {
+			completed += __atomic_load_n(&wd->slots[i]->completed, __ATOMIC_RELAXED);
+			start = __atomic_load_n(&wd->slots[i]->start_ns, __ATOMIC_ACQUIRE);
+			if (!start || now < start || (elapsed = now - start) < wd->timeout_ns)
+				continue;
+			if (wd->slots[i]->reported != start)
+				report_hang(wd, wd->slots[i], start, elapsed);
+			else if (elapsed >= 2 * wd->timeout_ns)
+				stuck = true;
+		}
+
+		if (completed != last_completed) {
+			last_completed = completed;
+			last_progress = now;
+		} else if (stuck && now - last_progress >= wd->timeout_ns) {
+			give_up(wd);
+		}
+	}
+	return NULL;
+}
+
+int watchdog_start(struct watchdog *wd)
+{
+	struct sigaction sa = { .sa_handler = handle_watchdog_signal };
+	int err;
+
+	/* No SA_RESTART, so that an interruptible write fails with -EINTR. */
+	sigemptyset(&sa.sa_mask);
+	if (sigaction(WATCHDOG_SIGNAL, &sa, NULL))
+		return -errno;
+
+	err = -pthread_create(&wd->thread, NULL, watchdog_thread, wd);
+	if (!err)
+		wd->running = true;
+	return err;
+}
+
+void destroy_watchdog(struct watchdog *wd)
+{
+	size_t i;
+
+	if (wd->running) {
+		wd->stop = true;
+		pthread_join(wd->thread, NULL);
+	}
+	for (i = 0; i < wd->num_slots; i++)
+		free(wd->slots[i]);
+	for (i = 0; i < wd->num_targets; i++) {
+		free(wd->targets[i]->name);
+		free(wd->targets[i]);
+	}
+	free(wd->slots);
+	free(wd->targets);
+	free(wd->hang_dir);
+	free(wd);
+}
@@ -0,0 +1,150 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Watchdog detecting inputs on which a target hangs
+ *
+ * Copyright 2025 Google LLC
+ */
+#ifndef WATCHDOG_H
+#define WATCHDOG_H 1
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "stats.h"
+#include "timing.h"
+
+/* Exit status of a bridge that the watchdog found unable to make progress. */
+#define WATCHDOG_EXIT_STATUS 3
+
+/**
+ * struct watchdog_target - watchdog state shared by every worker of a target
+ *
+ * @name: the target's name.
+ * @quarantined: set once an input has hung the target. Workers stop sending
+ *	it inputs.
+ */
+struct watchdog_target {
+	char *name;
+	bool quarantined;
+};
+
+/**
+ * struct watchdog_slot - one worker's injection, as seen by the watchdog
+ *
+ * @start_ns: time at which the current write started, or 0 if the worker is
+ *	not writing.
+ * @data, @len: the input being written.
+ * @completed: number of writes the worker has finished.
+ * @busy: set by the watchdog while it reads @data.
+ * @target: state shared with the target's other workers.
+ * @stats: if set, hangs are counted here.
+ * @thread: the worker's thread, which is signalled to interrupt a hung write.
+ * @reported: the value of @start_ns for which a hang was last reported.
+ *
+ * @start_ns, @data, @len, @completed and @thread are written by the worker,
+ * and the remaining fields by the watchdog.
+ */
+struct watchdog_slot {
+	uint64_t start_ns;
+	const char *data;
+	size_t len;
+	uint64_t completed;
+	int busy;
+
+	struct watchdog_target *target;
+	struct stats *stats;
+	pthread_t thread;
+	uint64_t reported;
+} __attribute__((aligned(64)));
+
+/**
+ * struct watchdog - background thread watching every worker's writes
+ *
+ * An input whose write takes longer than @timeout_ns is saved under
+ * @hang_dir, counted as a hang in the target's stats, and its target is
+ * quarantined. The watchdog then signals the hung worker, which makes the
+ * write fail with -EINTR if the target sleeps interruptibly. If the write is
+ * still hung after another @timeout_ns and no other worker has made progress
+ * in the meantime, the process can no longer finish on its own, and the
+ * watchdog writes a final stats dump and exits with WATCHDOG_EXIT_STATUS.
+ */
+struct watchdog {
+	uint64_t timeout_ns;
+	char *hang_dir;
+	struct stats_collector *sc;
+
+	struct watchdog_target **targets;
+	size_t num_targets;
+	struct watchdog_slot **slots;
+	size_t num_slots;
+
+	pthread_t thread;
+	bool running;
+	volatile bool stop;
+};
+
+/**
+ * watch_begin - announce that a worker is about to write an input
+ *
+ * @data must stay valid until the matching watch_end().
+ */
+static inline void watch_begin(struct watchdog_slot *s, const char *data, size_t len)
+{
+	s->data = data;
+	s->len = len;
+	__atomic_store_n(&s->start_ns, now_ns(), __ATOMIC_RELEASE);
+}
+
+/**
+ * watch_end - announce that a write has returned
+ *
+ * Waits for the watchdog to finish reading the input, if it is doing so.
+ */
+static inline void watch_end(struct watchdog_slot *s)
+{
+	/* Pairs with the watchdog setting @busy before re-reading @start_ns. */
+	__atomic_store_n(&s->start_ns, 0, __ATOMIC_SEQ_CST);
+	while (__atomic_load_n(&s->busy, __ATOMIC_SEQ_CST))
+		sched_yield();
+	__atomic_store_n(&s->completed, s->completed + 1, __ATOMIC_RELAXED);
+}
+
+static inline bool watch_quarantined(const struct watchdog_slot *s)
+{
+	return __atomic_load_n(&s->target->quarantined, __ATOMIC_RELAXED);
+}
+
+/**
+ * new_watchdog - create a watchdog
+ *
+ * @timeout_ns: time after which a write is considered hung.
+ * @hang_dir: directory in which hung inputs are saved.
+ * @sc: if set, dumped before the watchdog gives up on the process.
+ *
+ * @return the new watchdog, or NULL on failure.
+ */
+struct watchdog *new_watchdog(uint64_t timeout_ns, const char *hang_dir, struct stats_collector *sc);
+
+/**
+ * watchdog_add - allocate and register a slot for one worker
+ *
+ * Must be called before watchdog_start(). Slots with the same @target share
+ * their quarantine.
+ *
+ * @return the new slot, owned by the watchdog, or NULL.
+ */
+struct watchdog_slot *watchdog_add(struct watchdog *wd, const char *target, struct stats *stats);
+
+/**
+ * watchdog_start - start watching from a background thread
+ *
+ * @return 0 on success or a negative errno on failure.
+ */
+int watchdog_start(struct watchdog *wd);
+
+void destroy_watchdog(struct watchdog *wd);
+
+#endif /* WATCHDOG_H */
@@ -0,0 +1,468 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Encode-and-inject workers driving a single KFuzzTest target
+ *
+ * Copyright 2025 Google LLC
+ */
+#include <asm-generic/errno-base.h>
+#include <errno.h>
+#include <string.h>
+
+#include "arena.h"
+#include "corpus.h"
+#include "dictionary.h"
+#include "kfuzztest_encoder.h"
+#include "mutator.h"
+#include "provenance.h"
+#include "shm_ring.h"
+#include "sink.h"
+#include "spsc_ring.h"
+#include "stats.h"
+#include "timing.h"
+#include "uring_backend.h"
+#include "watchdog.h"
+#include "worker.h"
+
+static int invoke_kfuzztest_target(struct worker *w, const char *data, size_t data_size)
+{
+	int err;
+
+	if (!w->watch)
+		return sink_write(w->sink, w->target, data, data_size);
+
+	watch_begin(w->watch, data, data_size);
+	err = sink_write(w->sink, w->target, data, data_size);
+	watch_end(w->watch);
+	return err;
+}
+
+/* Where the fields of the last encoded input went. */
+static const struct template_field *input_fields(const struct worker *w)
+{
+	return w->fields ? w->fields : w->tmpl->fields;
+}
+
+/*
+ * Produces the next input in mutation mode: either a fresh encoding, or the
+ * previous input with a few of its fields mutated in place. Either way, the
+ * input is left in @w->last for the next call.
+ */
+static int mutate_input(struct worker *w, struct rand_stream *rs, size_t *num_bytes)
+{
+	int err;
+
+	if (w->num_mutated < w->mutate_inputs) {
+		if ((err = mutate(input_fields(w), w->tmpl->num_fields, w->dict, rs, w->last)))
+			return err;
+		w->num_mutated++;
+		*num_bytes = w->last_size;
+		return 0;
+	}
+
+	err = encode_into(w->tmpl, rs, NULL, w->last, w->tmpl->size, w->fields, num_bytes);
+	if (!err && w->dict)
+		err = dictionary_fill(w->dict, w->tmpl, input_fields(w), rs, NULL, w->last);
+	/* A partially encoded input must not be mutated. */
+	w->num_mutated = err ? w->mutate_inputs : 0;
+	w->last_size = *num_bytes;
+	return err;
+}
+
+/*
+ * Encodes the next input, drawing its bytes from the worker's rand_stream or,
+ * in corpus mode, from the next seed file, or from the next shared-memory slot.
+ * The input is written to @buf if it is set, which must have room for it, or
+ * else to the worker's arena, and returned in @ret.
+ */
+static int encode_input(struct worker *w, char *buf, size_t *num_bytes, char **ret)
+{
+	uint64_t input = w->first_input + w->num_execs * w->input_stride;
+	struct rand_stream *rs = w->rs;
+	struct rand_stream slot_rs;
+	int err;
+
+	/* The previous input has been injected or copied to io_uring by now. */
+	arena_reset(w->arena);
+
+	if (w->cursor && (err = corpus_next(w->cursor, &rs)))
+		goto out;
+	if (rs && rs->type == RAND_STREAM_PRNG)
+		rand_stream_seek_input(rs, input);
+	if (w->ring) {
+		if ((err = shm_ring_next(w->ring, w->stop, w->deadline, &slot_rs)))
+			goto out;
+		rs = &slot_rs;
+	}
+
+	if (w->mutate_inputs) {
+		err = mutate_input(w, rs, num_bytes);
+		/* Queued io_uring slots are still being written, so the input cannot live there. */
+		if (!err && buf)
+			memcpy(buf, w->last, *num_bytes);
+		*ret = buf ? buf : w->last;
+	} else if (buf) {
+		err = encode_into(w->tmpl, rs, w->prov, buf, w->tmpl->size, w->fields, num_bytes);
+		*ret = buf;
+	} else {
+		err = encode(w->tmpl, rs, w->prov, w->arena, w->fields, num_bytes, ret);
+	}
+	/* Mutated inputs only take interesting values through their mutations. */
+	if (!err && w->dict && !w->mutate_inputs)
+		err = dictionary_fill(w->dict, w->tmpl, input_fields(w), rs, w->prov, *ret);
+	if (w->cursor)
+		destroy_rand_stream(rs);
+	if (!err && w->prov)
+		provenance_log_input(w->prov_log, w->prov, input, *num_bytes);
+out:
+	if (err && err != -ENODATA && w->stats)
+		stats_inc(&w->stats->encode_errors, 1);
+	return err;
+}
+
+/*
+ * Encodes a single input from the rand_stream and injects it into the target.
+ * This is the only work done per iteration; the schema is compiled once up
+ * front.
+ */
+static int invoke_one(struct worker *w)
+{
+	uint64_t latency_ns = 0;
+	size_t num_bytes;
+	uint64_t start;
+	char *input;
+	int err;
+
+	err = encode_input(w, NULL, &num_bytes, &input);
+	if (err)
+		goto out;
+
+	if (w->stats || w->ring) {
+		start = now_ns();
+		err = invoke_kfuzztest_target(w, input, num_bytes);
+		latency_ns = now_ns() - start;
+		if (w->stats)
+			stats_record(w->stats, num_bytes, err, latency_ns);
+	} else {
+		err = invoke_kfuzztest_target(w, input, num_bytes);
+	}
+out:
+	/* -ENODATA means no slot was taken from the ring. */
+	if (w->ring && err != -ENODATA)
+		shm_ring_complete(w->ring, err, latency_ns);
+	return err;
+}
+
+static void on_uring_complete(void *arg, const struct uring_completion *c)
+{
+	struct worker *w = arg;
+
+	if (w->stats)
+		stats_record(w->stats, c->len, c->res, c->latency_ns);
+	if (!c->res)
+		return;
+	w->num_failed++;
+	if (w->fail_fast && !w->err)
+		w->err = c->res;
+}
+
+int worker_enable_uring(struct worker *w, unsigned int depth)
+{
+	if (w->sink->type != SINK_DEBUGFS)
+		return -ENOSYS;
+	w->uring = new_uring_backend(w->target, depth, on_uring_complete, w);
+	if (!w->uring)
+		return -ENOSYS;
+	/* Submit half the ring at a time, so one half encodes while the other is in flight. */
+	w->uring_batch = w->uring->depth > 1 ? w->uring->depth / 2 : 1;
+	return 0;
+}
+
+void worker_disable_uring(struct worker *w)
+{
+	if (w->uring)
+		destroy_uring_backend(w->uring);
+	w->uring = NULL;
+}
+
+int worker_enable_pipeline(struct worker *w, unsigned int depth)
+{
+	w->pipeline = new_spsc_ring(w->tmpl->size, depth);
+	return w->pipeline ? 0 : -ENOMEM;
+}
+
+void worker_disable_pipeline(struct worker *w)
+{
+	if (w->pipeline)
+		destroy_spsc_ring(w->pipeline);
+	w->pipeline = NULL;
+}
+
+int worker_enable_provenance(struct worker *w, struct provenance_log *log, const char *target)
+{
+	w->prov = new_provenance(target);
+	if (!w->prov)
+		return -ENOMEM;
+	w->prov_log = log;
+	return 0;
+}
+
+void worker_disable_provenance(struct worker *w)
+{
+	if (w->prov)
+		destroy_provenance(w->prov);
+	w->prov = NULL;
+	w->prov_log = NULL;
+}
+
+void worker_release(struct worker *w)
+{
+	if (w->arena)
+		destroy_arena(w->arena);
+	w->arena = NULL;
+	free(w->last);
+	w->last = NULL;
+	free(w->fields);
+	w->fields = NULL;
+}
+
+/*
+ * Like invoke_one(), but queues the input on the worker's io_uring instead of
+ * writing it synchronously. The input is encoded straight into its ring slot.
+ * Injection failures are accounted for when the completion is reaped, in
+ * on_uring_complete().
+ */
+static int invoke_one_uring(struct worker *w)
+{
+	unsigned int slot;
+	size_t num_bytes;
+	char *buf;
+	int err;
+
+	buf = uring_get_slot(w->uring, w->tmpl->size, &slot);
+	if (!buf)
+		return -ENOMEM;
+	err = encode_input(w, buf, &num_bytes, &buf);
+	if (err) {
+		uring_put_slot(w->uring, slot);
+		return err;
+	}
+
+	uring_queue(w->uring, slot, num_bytes, w->num_execs);
+	if (w->uring->to_submit >= w->uring_batch)
+		return uring_submit(w->uring);
+	return 0;
+}
+
+/*
+ * Like invoke_one_uring(), but hands the input to the pipeline's injector
+ * thread. A buffer that failed to encode is not published, so the next input
+ * reuses it.
+ */
+static int invoke_one_pipeline(struct worker *w)
+{
+	size_t num_bytes;
+	char *buf;
+	int err;
+
+	if (w->fail_fast && (err = __atomic_load_n(&w->inject_err, __ATOMIC_RELAXED)))
+		return err;
+	buf = spsc_ring_reserve(w->pipeline);
+	if ((err = encode_input(w, buf, &num_bytes, &buf)))
+		return err;
+	spsc_ring_publish(w->pipeline, num_bytes);
+	return 0;
+}
+
+int worker_run(struct worker *w)
+{
+	int err;
+
+	w->err = 0;
+	w->num_failed = 0;
+	if (!w->arena && !(w->arena = new_arena(ENCODE_ARENA_CHUNK_SIZE))) {
+		w->err = -ENOMEM;
+		return w->err;
+	}
+	if (w->tmpl->num_ranges && !w->fields &&
+	    !(w->fields = malloc((w->tmpl->num_fields + w->tmpl->num_lens) * sizeof(struct template_field)))) {
+		w->err = -ENOMEM;
+		return w->err;
+	}
+	if (w->mutate_inputs && !w->last) {
+		if (!(w->last = malloc(w->tmpl->size))) {
+			w->err = -ENOMEM;
+			return w->err;
+		}
+		/* Start with a fresh encoding. */
+		w->num_mutated = w->mutate_inputs;
+	}
+	/* A pipeline's writes are made, and watched, on its injector thread. */
+	if (w->watch && !w->pipeline)
+		w->watch->thread = pthread_self();
+	for (w->num_execs = 0; !w->iterations || w->num_execs < w->iterations; w->num_execs++) {
+		if (*w->stop || (w->deadline && now_ns() >= w->deadline))
+			break;
+		if (w->watch && watch_quarantined(w->watch))
+			break;
+
+		if (w->pipeline)
+			err = invoke_one_pipeline(w);
+		else
+			err = w->uring ? invoke_one_uring(w) : invoke_one(w);
+		if (err == -ENODATA) {
+			/* The input source ran dry; end the loop cleanly. */
+			w->exhausted = true;
+			if (w->num_execs == 0 && w->fail_fast) {
+				w->err = err;
+				return err;
+			}
+			break;
+		}
+		if (err && w->fail_fast) {
+			w->err = err;
+			break;
+		}
+		if (err)
+			w->num_failed++;
+	}
+
+	/* Wait for every queued input, so that its outcome is accounted for. */
+	if (w->uring && (err = uring_drain(w->uring)) && !w->err)
+		w->err = err;
+	return w->err;
+}
+
+static void *worker_thread(void *arg)
+{
+	struct worker *w = arg;
+
+	worker_run(w);
+	if (w->pipeline)
+		spsc_ring_close(w->pipeline);
+	return NULL;
+}
+
+int run_workers(struct worker *workers, size_t num_workers)
+{
+	size_t started;
+	size_t i;
+	int err = 0;
+
+	for (started = 0; started < num_workers; started++) {
+		err = -pthread_create(&workers[started].thread, NULL, worker_thread, &workers[started]);
+		if (err)
+			break;
+	}
+
+	for (i = 0; i < started; i++) {
+		pthread_join(workers[i].thread, NULL);
+		if (!err)
+			err = workers[i].err;
+	}
+	return err;
+}
+
+/* Writes one input of a pipelined worker, on the injector thread. */
+static void inject_pipelined(struct worker *w, const char *input, size_t num_bytes)
+{
+	uint64_t start;
+	int err;
+
+	if (w->stats) {
+		start = now_ns();
+		err = invoke_kfuzztest_target(w, input, num_bytes);
+		stats_record(w->stats, num_bytes, err, now_ns() - start);
+	} else {
+		err = invoke_kfuzztest_target(w, input, num_bytes);
+	}
+	if (!err)
+		return;
+	w->inject_failed++;
+	if (!w->inject_err)
+		__atomic_store_n(&w->inject_err, err, __ATOMIC_RELAXED);
+}
+
+/* Whether any worker of a pipeline has an input ready for the injector. */
+static bool pipeline_ready(struct worker *workers, size_t num_workers)
+{
+	size_t i;
+
+	for (i = 0; i < num_workers; i++) {
+		if (spsc_ring_ready(workers[i].pipeline))
+			return true;
+	}
+	return false;
+}
+
+int run_pipeline(struct worker *workers, size_t num_workers)
+{
+	struct spsc_doorbell doorbell = { 0 };
+	size_t num_open = num_workers;
+	size_t started;
+	size_t num_bytes;
+	uint32_t seen;
+	bool busy;
+	char *input;
+	size_t i;
+	int err = 0;
+	int ret;
+
+	for (i = 0; i < num_workers; i++) {
+		workers[i].inject_failed = 0;
+		workers[i].inject_err = 0;
+		workers[i].pipeline->doorbell = &doorbell;
+		if (workers[i].watch)
+			workers[i].watch->thread = pthread_self();
+	}
+
+	for (started = 0; started < num_workers; started++) {
+		err = -pthread_create(&workers[started].thread, NULL, worker_thread, &workers[started]);
+		if (err)
+			break;
+	}
+	/* Close the rings of workers that never started, as they will not. */
+	for (i = started; i < num_workers; i++)
+		spsc_ring_close(workers[i].pipeline);
+
+	/*
+	 * Take one input from each worker that has one ready, so that a worker
+	 * busy encoding a large input holds up no other, until every ring is
+	 * closed. Only sleep once every ring is empty.
+	 */
+	while (num_open) {
+		busy = false;
+		num_open = 0;
+		for (i = 0; i < num_workers; i++) {
+			ret = spsc_ring_try_next(workers[i].pipeline, &input, &num_bytes);
+			if (ret == -ENODATA)
+				continue;
+			num_open++;
+			if (ret)
+				continue;
+			inject_pipelined(&workers[i], input, num_bytes);
+			spsc_ring_release(workers[i].pipeline);
+			busy = true;
+		}
+		if (busy || !num_open)
+			continue;
+
+		seen = spsc_doorbell_arm(&doorbell);
+		if (pipeline_ready(workers, num_workers))
+			spsc_doorbell_disarm(&doorbell);
+		else
+			spsc_doorbell_wait(&doorbell, seen);
+	}
+
+	/* A producer may still ring the doorbell while closing its ring. */
+	for (i = 0; i < started; i++) {
+		pthread_join(workers[i].thread, NULL);
+		workers[i].num_failed += workers[i].inject_failed;
+		if (!workers[i].err && workers[i].fail_fast)
+			workers[i].err = workers[i].inject_err;
+		if (!err)
+			err = workers[i].err;
+	}
+	for (i = 0; i < num_workers; i++)
+		workers[i].pipeline->doorbell = NULL;
+	return err;
+}
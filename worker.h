@@ -0,0 +1,211 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Encode-and-inject workers driving a single KFuzzTest target
+ *
+ * Copyright 2025 Google LLC
+ */
+#ifndef WORKER_H
+#define WORKER_H 1
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "dictionary.h"
+#include "kfuzztest_encoder.h"
+#include "rand_stream.h"
+#include "target_registry.h"
+
+/* Number of buffers between each producer and the injector of a pipeline, unless told otherwise. */
+#define PIPELINE_DEFAULT_DEPTH 8
+
+struct corpus_cursor;
+struct provenance;
+struct provenance_log;
+struct shm_ring;
+struct sink;
+struct spsc_ring;
+struct stats;
+struct uring_backend;
+struct watchdog_slot;
+
+/**
+ * struct worker - a single encode-and-inject loop
+ *
+ * @tmpl: the schema's layout. Shared between workers and never written.
+ * @rs: this worker's private byte source.
+ * @cursor: if set, each input is instead encoded from the next seed file of
+ *	a corpus.
+ * @ring: if set, each input is instead encoded in place from the next slot of
+ *	a shared-memory ring, and its outcome is written back to the slot.
+ * @target: this worker's private handle on the fuzz target, or NULL if @sink
+ *	does not write to debugfs.
+ * @sink: where encoded inputs are delivered.
+ * @iterations: number of inputs to inject, or 0 for no limit.
+ * @first_input, @input_stride: the n-th input of the next worker_run() is
+ *	numbered @first_input + n * @input_stride, which seeds its bytes if @rs
+ *	is a RAND_STREAM_PRNG stream and labels its provenance.
+ * @deadline: CLOCK_MONOTONIC time in ns at which to stop, or 0 for none.
+ * @stop: set asynchronously to ask the worker to stop.
+ * @fail_fast: return the first encode or injection failure as an error.
+ * @uring: if set, inputs are injected in batches through this io_uring.
+ * @uring_batch: number of queued inputs that triggers a submission.
+ * @pipeline: if set, inputs are encoded into the buffers of this ring and
+ *	injected by run_pipeline()'s injector thread instead.
+ * @stats: if set, every injection is recorded here.
+ * @watch: if set, every write is watched for hangs, and the worker stops once
+ *	its target has been quarantined.
+ * @prov, @prov_log: if set, the provenance of every input's fields is
+ *	recorded in @prov and appended to @prov_log.
+ * @arena: holds the input being encoded and injected, and is reset before
+ *	the next one. Created by the worker's own thread on first use.
+ * @mutate_inputs: if set, inputs are kept in @last, and each freshly encoded
+ *	input is followed by this many inputs that mutate the previous one in
+ *	place. Incompatible with @cursor, @ring and @prov.
+ * @last: the last input, allocated on first use if @mutate_inputs is set.
+ * @last_size: the size of @last.
+ * @fields: if the schema has ranged arrays, where the fields of the last
+ *	encoded input went. Allocated on first use.
+ * @dict: if set, interesting values that primitives are mixed with.
+ * @num_mutated: number of inputs mutated since @last was last encoded afresh.
+ * @num_execs: number of inputs injected by the last worker_run().
+ * @num_failed: how many of those failed to encode or inject.
+ * @err: the error that ended the loop, if any.
+ * @exhausted: set once the byte source has run dry.
+ * @inject_failed, @inject_err: the number of failed injections of a pipeline
+ *	and the first of their errors, written by its injector thread. They are
+ *	folded into @num_failed, and with @fail_fast into @err, once the
+ *	pipeline has ended.
+ *
+ * Everything a worker touches on its hot path lives in its own struct, which
+ * is cacheline-aligned so that workers running side by side never share a
+ * line.
+ */
+struct worker {
+	const struct encode_template *tmpl;
+	struct rand_stream *rs;
+	struct corpus_cursor *cursor;
+	struct shm_ring *ring;
+	struct kfuzztest_target *target;
+	struct sink *sink;
+	uint64_t iterations;
+	uint64_t first_input;
+	uint64_t input_stride;
+	uint64_t deadline;
+	const volatile sig_atomic_t *stop;
+	bool fail_fast;
+	struct uring_backend *uring;
+	unsigned int uring_batch;
+	struct spsc_ring *pipeline;
+	struct stats *stats;
+	struct watchdog_slot *watch;
+	struct provenance *prov;
+	struct provenance_log *prov_log;
+	struct arena *arena;
+	uint64_t mutate_inputs;
+	char *last;
+	size_t last_size;
+	struct template_field *fields;
+	uint64_t num_mutated;
+	const struct dictionary *dict;
+
+	uint64_t num_execs;
+	uint64_t num_failed;
+	int err;
+	bool exhausted;
+
+	/* Written by another thread, so kept off the lines above. */
+	uint64_t inject_failed __attribute__((aligned(64)));
+	int inject_err;
+
+	pthread_t thread;
+} __attribute__((aligned(64)));
+
+/**
+ * worker_run - run a worker's loop on the calling thread
+ *
+ * The loop ends when the iteration count or deadline is reached, when *stop
+ * is set, when the target is quarantined, or when the byte source is
+ * exhausted. Failed encodes or injections
+ * are counted, unless @fail_fast is set, in which case they end the loop.
+ *
+ * @return 0 on success or a negative errno on failure.
+ */
+int worker_run(struct worker *w);
+
+/**
+ * worker_enable_uring - inject this worker's inputs through io_uring
+ *
+ * @w: a worker whose target has been set.
+ * @depth: maximum number of inputs in flight.
+ *
+ * Inputs are submitted in batches of half the ring, and their completions are
+ * reaped while the next batch is being encoded.
+ *
+ * @return 0 on success, or -ENOSYS if io_uring is unavailable or the worker's
+ * sink does not write to debugfs, in which case the worker keeps using
+ * synchronous writes.
+ */
+int worker_enable_uring(struct worker *w, unsigned int depth);
+
+void worker_disable_uring(struct worker *w);
+
+/**
+ * worker_enable_pipeline - hand this worker's inputs to an injector thread
+ *
+ * @w: the worker.
+ * @depth: the number of inputs in flight between the worker and the injector.
+ *
+ * The worker then only encodes, into a pool of @depth preallocated buffers,
+ * and must be run by run_pipeline().
+ *
+ * @return 0 on success or -ENOMEM.
+ */
+int worker_enable_pipeline(struct worker *w, unsigned int depth);
+
+void worker_disable_pipeline(struct worker *w);
+
+/**
+ * worker_enable_provenance - log where the fields of each input came from
+ *
+ * @w: the worker.
+ * @log: the log to append to, shared with other workers.
+ * @target: the target name to label the worker's inputs with.
+ *
+ * @return 0 on success or -ENOMEM.
+ */
+int worker_enable_provenance(struct worker *w, struct provenance_log *log, const char *target);
+
+void worker_disable_provenance(struct worker *w);
+
+/* Releases the memory that a worker allocated for itself while running. */
+void worker_release(struct worker *w);
+
+/**
+ * run_workers - run several workers concurrently and wait for them
+ *
+ * @workers: array of initialized workers.
+ * @num_workers: length of @workers.
+ *
+ * @return 0 if every worker succeeded, otherwise the first worker's error.
+ */
+int run_workers(struct worker *workers, size_t num_workers);
+
+/**
+ * run_pipeline - run pipelined workers, injecting their inputs on this thread
+ *
+ * @workers: array of initialized workers, each with its pipeline enabled.
+ * @num_workers: length of @workers.
+ *
+ * Every worker runs on a thread of its own, encoding into its pipeline, while
+ * the calling thread takes the workers' inputs in turn, writes each to its
+ * worker's target, and returns the buffer to the worker. Encoding thus
+ * overlaps with the target's execution, and in steady state neither side
+ * allocates, copies an input or takes a lock.
+ *
+ * @return 0 if every worker succeeded, otherwise the first worker's error.
+ */
+int run_pipeline(struct worker *workers, size_t num_workers);
+
+#endif /* WORKER_H */